@@ -0,0 +1,42 @@
+/*
+ * acpll.h
+ *
+ *  Software PLL of the AC power
+ *  The AC_ZERO pin receives pulse on every zero crossing of the AC power (100 or 120 Hz).
+ *  The AC_ZERO interrupt measures the AC half period and the phase of TIM2 counter at the zero crossing.
+ *  TIM2 period is slightly changed to keep TIM2 synchronized with the AC power
+ */
+
+#ifndef ACPLL_H_
+#define ACPLL_H_
+
+#include "main.h"
+
+class AC_PLL {
+	public:
+		AC_PLL(void)										{ }
+		void		init(void);
+		void		zeroCross(void);						// AC_ZERO interrupt handler
+		bool		acPresent(void);						// Whether the AC_ZERO pulses are received
+		bool		isLocked(void)							{ return locked && acPresent(); }
+		uint16_t	frequency(void);						// The AC power frequency (Hz * 10)
+	private:
+		volatile uint32_t	last_cycle		= 0;			// CPU cycle counter at the previous zero crossing
+		volatile uint32_t	last_ms			= 0;			// The time of the previous zero crossing (ms)
+		volatile uint32_t	half_period		= 0;			// The exponential average of the half period (cycles * hp_emp_k)
+		volatile int32_t	i_summ			= 0;			// The summary of phase errors
+		volatile uint8_t	good_edges		= 0;			// Number of zero crossings with low phase error
+		volatile bool		locked			= false;		// TIM2 is synchronized to the AC power
+		volatile bool		synced			= false;		// The PLL was locked once, do not move TIM2 counter any more
+		const uint16_t		tim2_period		= 2000;			// Nominal TIM2 period (TIM2.Init.Period + 1)
+		const int16_t		max_adjust		= 10;			// Maximum TIM2 period correction (ticks)
+		const int16_t		lock_error		= 3;			// Maximum phase error of the locked PLL (ticks)
+		const uint8_t		lock_edges		= 8;			// Number of good zero crossings to lock the PLL
+		const int16_t		snap_error		= 50;			// Move TIM2 counter immediately at startup if the phase error is greater
+		const uint8_t		hp_emp_k		= 8;			// The half period exponential average coefficient
+		const uint8_t		min_hp_ms		= 6;			// Minimum half period of AC power (ms), shorter pulses are noise
+		const uint8_t		max_hp_ms		= 12;			// Maximum half period of AC power (ms), longer gap means the AC_ZERO pulse missed
+		const uint8_t		ac_timeout		= 40;			// No AC_ZERO pulses timeout (ms)
+};
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * budget.h
+ *
+ *  The power budget of the IRON and the Hot Air Gun working together
+ */
+
+#ifndef BUDGET_H_
+#define BUDGET_H_
+
+#include "main.h"
+#include "core.h"
+
+/*
+ * Both heaters are supplied from the same mains circuit. The arbiter limits the power drawn by them together:
+ * - Peak: if the budget is less than both heaters full power, the IRON is not powered while the Hot Air Gun triac is on.
+ *   The IRON power cut is postponed to the periods when the Hot Air Gun is off, so the heaters are interleaved
+ *   across the mains half-waves.
+ * - Average: the Hot Air Gun power is limited once per TIM1 period, so the average power of both heaters does not
+ *   exceed the budget and the IRON has enough time to get the postponed power.
+ * The device being used (priority) gets the power first, the other one keeps at least min_share percents of its request
+ */
+class PWR_BUDGET {
+	public:
+		PWR_BUDGET(void)								{ }
+		void		init(uint16_t watts);				// Setup the power budget in watts, 0 - no limit
+		void		priority(bool gun)					{ gun_first = gun;	}
+		uint16_t	gun(uint16_t request);				// The Hot Air Gun power (half-waves of the TIM1 period) granted
+		uint16_t	iron(uint16_t request, uint16_t max_pwm, bool gun_on);	// The IRON power granted for the next TIM2 period
+		uint32_t	statistics(t_pwr_stat stat);
+	private:
+		volatile	uint16_t	budget		= 0;		// The total power budget (watts)
+		volatile	bool		gun_first	= false;	// The Hot Air Gun has priority
+		volatile	uint32_t	iron_debt	= 0;		// The IRON power postponed while the Hot Air Gun was on (TIM2 ticks)
+		volatile	uint32_t	iron_sum	= 0;		// Summary of the IRON power requests in current TIM1 period
+		volatile	uint16_t	iron_cnt	= 0;		// Number of the IRON power requests in current TIM1 period
+		volatile	uint16_t	iron_max	= 0;		// The IRON power limit of the TIM2 period (TIM2 ticks)
+		volatile	uint16_t	peak_watts	= 0;		// The peak power of both heaters
+		volatile	uint32_t	iron_cut	= 0;		// Number of the IRON periods postponed
+		volatile	uint32_t	gun_cut		= 0;		// Number of the Hot Air Gun half-waves cut
+		const uint16_t	gun_watts		= 700;			// The Hot Air Gun heater power
+		const uint16_t	iron_watts		= 72;			// The IRON heater power: 24 volts, 8 Ohm
+		const uint16_t	mains_volts		= 230;			// Nominal mains voltage to calculate the peak current
+		const uint16_t	iron_ticks		= 2000;			// The IRON full power, TIM2 period
+		const uint16_t	gun_half_waves	= 100;			// The Hot Air Gun full power, TIM1 period
+		const uint8_t	min_share		= 25;			// The power share of the device without priority, percents
+		const uint32_t	max_debt		= 2000*25;		// The IRON postponed power limit, half a second of full power
+};
+
+#endif
@@ -15,8 +15,12 @@
  * CFG_BUZZER		- Is the Buzzer Enabled (1)
  * CFG_KEEP_IRON	- Is keep the iron working while in Hot Air Gun mode
  * CFG_SWITCH		- Switch type: Tilt (0) or REED (1)
+ * CFG_FAST_IRON	- The IRON control loop rate: 50 Hz (0) or 100 Hz (1)
+ * CFG_GUN_PREDICT	- Use the dead time compensation (Smith predictor) in the Hot Air Gun PID
+ * CFG_GUN_BURST	- Spread the Hot Air Gun power over the TIM1 period (burst fire)
  */
-typedef enum { CFG_CELSIUS = 1, CFG_BUZZER = 2, CFG_KEEP_IRON = 4, CFG_SWITCH = 8, CFG_BIG_STEP = 128 } CFG_BIT_MASK;
+typedef enum { CFG_CELSIUS = 1, CFG_BUZZER = 2, CFG_KEEP_IRON = 4, CFG_SWITCH = 8, CFG_FAST_IRON = 16, CFG_GUN_PREDICT = 32,
+	CFG_GUN_BURST = 64, CFG_BIG_STEP = 128 } CFG_BIT_MASK;
 
 /* Configuration record in the EEPROM (after the tip table) has the following format:
  * Records are aligned by 2**n bytes (in this case, 32 bytes)
@@ -48,22 +52,73 @@ struct s_config {
 	uint8_t		bit_mask;							// See CFG_BIT_MASK
 };
 
+/*
+ * The IRON PID gain schedule. The PID coefficients are set up in the temperature bands, the band centers are
+ * the tip calibration reference points (200, 260, 330, 400 Celsius). Between the band centers the coefficients
+ * are interpolated. If the band is not set up (see mask), the coefficients from the configuration record are used.
+ * The power budget setup (see PWR_BUDGET) and the tip area layout flag do not fit the configuration record,
+ * they are kept here as well. The schedule is saved in the last chunk of the configuration area
+ */
+#define		PID_BANDS		(4)
+typedef struct s_pid_schedule PID_SCHEDULE;
+struct s_pid_schedule {
+	uint16_t	ID;									// The schedule record signature, see EEPROM::loadSchedule()
+	uint16_t	Kp[PID_BANDS];						// The PID coefficients in each band
+	uint16_t	Ki[PID_BANDS];
+	uint16_t	Kd[PID_BANDS];
+	uint8_t		mask;								// Bit N means the band N is set up
+	uint8_t		power_budget;						// The total power of the IRON and the Hot Air Gun (x100 watts), 0 - no limit
+	uint8_t		tip_layout;							// 1 if the tip area holds one record per chunk, see EEPROM::migrateTipArea()
+	uint8_t		reserved;
+	uint16_t	crc;								// CRC16 of the record, see EEPROM::dataCRC()
+};
+
+/*
+ * The first order plus dead time model of the Hot Air Gun identified by the PID autotune (see MAUTOPID),
+ * used by the dead time compensation (see SMITH). The times are in TIM1 periods (HOTGUN::power() call period).
+ * The fan reference currents are learned once per fan speed, see FAN_REG.
+ * The model is saved in the chunk before the PID gain schedule
+ */
+#define		FAN_REF_POINTS	(5)
+typedef struct s_gun_model GUN_MODEL;
+struct s_gun_model {
+	uint16_t	ID;									// The model record signature, see EEPROM::loadGunModel()
+	uint16_t	K;									// The static gain, internal units per power unit * 16. 0 - no model
+	uint16_t	T;									// The time constant
+	uint8_t		L;									// The dead time
+	uint8_t		reserved;
+	uint16_t	fan_pwm[FAN_REF_POINTS];			// The fan speed (PWM) of the reference point
+	uint16_t	fan_cur[FAN_REF_POINTS];			// The fan current at the speed with the clear nozzle, 0 - not learned
+	uint16_t	crc;								// CRC16 of the record, see EEPROM::dataCRC()
+};
+
 /* Configuration data of each initialized tip are saved in the upper area of the EEPROM.
- * Two tip record per one EEPROM chunk, as soon each tip recored requires 16 bytes only.
+ * One tip record per one EEPROM chunk, as soon each tip record requires 32 bytes.
  * The tip configuration record has the following format:
  * 4 reference temperature points
- * tip status bitmap
+ * tip status bitmap: TIP_ACTIVE, TIP_CALIBRATED and the learned feedforward coefficient in the upper bits (TIP_FF_MASK)
  * tip suffix name
+ * The IRON PID coefficients of the tip, Kp is zero if the tip uses the global PID coefficients from the configuration record
+ * The heat lag of the tip identified by the boost, zero if not learned
+ * The first part of the record (TIP_OLD_SIZE bytes) is the old tip record, two of them were saved in the EEPROM chunk.
+ * The old tip area is converted when the controller starts, see EEPROM::migrateTipArea(). If the old area keeps
+ * too many tips to be converted, the old records are used without the tip PID coefficients
  */
 
 typedef struct s_tip TIP;
 struct s_tip {
 	uint16_t	t200, t260, t330, t400;				// The internal temperature in reference points
-	uint8_t		mask;								// The bit mask: TIP_ACTIVE + TIP_CALIBRATED
+	uint8_t		mask;								// The bit mask: TIP_ACTIVE + TIP_CALIBRATED + feedforward coefficient
 	char		name[tip_name_sz];					// T12 tip name suffix, JL02 for T12-JL02
 	int8_t		ambient;							// The ambient temperature in Celsius when the tip being calibrated
 	uint8_t		crc;								// CRC checksum
+	uint16_t	pid_ID;								// The tip PID signature, distinguishes the record from the old one
+	uint16_t	Kp, Ki, Kd;							// The tip PID coefficients, Kp == 0 if not set up
+	uint8_t		boost_lag;							// The tip heat lag (20 ms periods), 0 if not learned, see IRON::identifyLag()
+	uint8_t		reserved[5];
+	uint16_t	pid_crc;							// CRC16 of the whole record, see EEPROM::dataCRC()
 };
+#define		TIP_OLD_SIZE	(16)					// The size of the tip record without the PID coefficients
 
 // This tip structure is used to show available tips when tip is activating
 typedef struct s_tip_list_item	TIP_ITEM;
@@ -86,5 +141,7 @@ struct s_tip_table {
 };
 
 typedef enum tip_status { TIP_ACTIVE = 1, TIP_CALIBRATED = 2 } TIP_STATUS;
+#define		TIP_FF_SHIFT	(2)						// The feedforward coefficient position in the tip mask, 0 - not learned yet
+#define		TIP_FF_MASK		(0xFC)
 
 #endif
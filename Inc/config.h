@@ -15,7 +15,7 @@
 #include "pid.h"
 #include "buzzer.h"
 
-typedef enum cfg_status {CFG_OK = 0, CFG_NO_TIP, CFG_READ_ERROR} CFG_STATUS;
+typedef enum cfg_status {CFG_OK = 0, CFG_NO_TIP, CFG_READ_ERROR, CFG_OLD_TIPS} CFG_STATUS;
 typedef enum temp_force {DEV_DEFAULT = 0, DEV_IRON = 1, DEV_GUN = 2} CFG_TEMP_DEVICE;
 
 /*
@@ -31,6 +31,9 @@ class CFG_CORE: public TIPS {
 		bool		isKeepIron(void)					{ return a_cfg.bit_mask & CFG_KEEP_IRON;}
 		bool		isReedType(void)					{ return a_cfg.bit_mask & CFG_SWITCH;	}
 		bool		isBigTempStep(void)					{ return a_cfg.bit_mask & CFG_BIG_STEP;	}
+		bool		isFastIron(void)					{ return a_cfg.bit_mask & CFG_FAST_IRON;}
+		bool		isGunPredictor(void)				{ return a_cfg.bit_mask & CFG_GUN_PREDICT;}
+		bool		isGunBurst(void)					{ return a_cfg.bit_mask & CFG_GUN_BURST;	}
 		uint16_t	tempPresetHuman(void) 				{ return a_cfg.iron_temp;				}
 		uint16_t	gunTempPreset(void)					{ return a_cfg.gun_temp;				}
 		uint16_t	gunFanPreset(void)					{ return a_cfg.gun_fan_speed;			}
@@ -38,13 +41,15 @@ class CFG_CORE: public TIPS {
 		uint16_t	getLowTemp(void)					{ return a_cfg.low_temp; 				}
 		uint8_t		getLowTO(void)						{ return a_cfg.low_to; 					}	// 5-seconds intervals
 		uint8_t		getScrTo(void)						{ return a_cfg.scr_save_timeout;		}
-		void		setup(uint8_t off_timeout, bool buzzer, bool celsius, bool keep_iron, bool reed, bool big_temp_step,
+		void		setup(uint8_t off_timeout, bool buzzer, bool celsius, bool keep_iron, bool reed, bool big_temp_step, bool fast_iron,
 						uint16_t low_temp, uint8_t low_to, uint8_t scr_saver);
 		void 		savePresetTempHuman(uint16_t temp_set);
 		void		saveGunPreset(uint16_t temp, uint16_t fan = 0);
 		uint8_t		boostTemp(void);
 		uint8_t		boostDuration(void);
 		void		saveBoost(uint8_t temp, uint8_t duration);
+		void		setGunPredictor(bool use);
+		void		setGunBurst(bool burst);
 		void		restoreConfig(void);
 		PIDparam	pidParams(bool iron);
 		PIDparam 	pidParamsSmooth(bool iron = true);
@@ -63,12 +68,18 @@ struct s_TIP_RECORD {
 	uint16_t	calibration[4];
 	uint8_t		mask;
 	int8_t		ambient;
+	uint16_t	Kp, Ki, Kd;								// The tip PID coefficients, Kp == 0 if not set up
+	uint8_t		boost_lag;								// The tip heat lag (20 ms periods), 0 if not learned
 };
 
 class TIP_CFG {
 	public:
 		TIP_CFG(void)									{ }
 		bool 		isTipCalibrated(void) 				{ return tip[0].mask & TIP_CALIBRATED; 	}
+		uint8_t		tipFeedForward(void)				{ return (tip[0].mask & TIP_FF_MASK) >> TIP_FF_SHIFT; }
+		bool		hasTipPID(void)						{ return tip[0].Kp != 0;				}
+		PIDparam	tipPID(void)						{ return PIDparam(tip[0].Kp, tip[0].Ki, tip[0].Kd); }
+		uint8_t		tipBoostLag(void)					{ return tip[0].boost_lag;				}
 		uint16_t	tempMinC(void)						{ return t_minC;						}
 		uint16_t	tempMaxC(void)						{ return t_maxC;						}
 		bool		gunActive(void)						{ return gun_active;					}
@@ -83,6 +94,9 @@ class TIP_CFG {
 		void		applyTipCalibtarion(uint16_t temp[4], int8_t ambient);
 		void		resetTipCalibration(void);
 	protected:
+		void		applyTipFeedForward(uint8_t ff);
+		void		applyTipBoostLag(uint8_t lag)		{ tip[0].boost_lag = lag;				}
+		void		applyTipPID(const TIP& ltip, bool gun = false);
 		void 		defaultCalibration(bool gun = false);
 		bool		isValidTipConfig(TIP *tip);
 	private:
@@ -106,10 +120,22 @@ class CFG : public EEPROM, public CFG_CORE, public TIP_CFG, public BUZZER {
 		void     	changeTip(uint8_t index);
 		uint8_t		currentTipIndex(void);
 		void		saveTipCalibtarion(uint8_t index, uint16_t temp[4], uint8_t mask, int8_t ambient);
+		void		saveTipFeedForward(uint8_t ff);
+		void		saveTipBoostLag(uint8_t lag);
 		bool		toggleTipActivation(uint8_t index);
 		int			tipList(uint8_t second, TIP_ITEM list[], uint8_t list_len, bool active_only);
 		void		saveConfig(void);
 		void		savePID(PIDparam &pp, bool iron = true);
+		PIDparam	pidParams(bool iron);				// The current tip PID coefficients or the global ones
+		bool		saveTipPID(PIDparam &pp);
+		PIDparam	pidBand(uint8_t band);				// The IRON PID coefficients in the temperature band
+		PIDparam	pidScheduled(uint16_t temp);		// The IRON PID coefficients interpolated for the temperature (internal units)
+		void		savePIDband(uint8_t band, PIDparam &pp);
+		uint16_t	powerBudget(void)					{ return pid_sched.power_budget * 100;	}	// Watts, 0 - no limit
+		void		savePowerBudget(uint16_t watts);
+		const GUN_MODEL&	gunModel(void)				{ return gun_model;						}	// K == 0 if not identified
+		bool		saveGunModel(uint16_t K, uint16_t T, uint8_t L);
+		bool		saveGunFan(const uint16_t pwm[FAN_REF_POINTS], const uint16_t cur[FAN_REF_POINTS]);
 		void 		initConfigArea(void);
 		void		clearAllTipsCalibration(void);
 	private:
@@ -119,6 +145,8 @@ class CFG : public EEPROM, public CFG_CORE, public TIP_CFG, public BUZZER {
 		uint8_t		freeTipChunkIndex(void);
 		bool 		isTipCorrect(uint8_t tip_chunk_index, TIP *tip);
 		TIP_TABLE	*tip_table = 0;						// Tip table - chunk number of the tip or 0xFF if does not exist in the EEPROM
+		PID_SCHEDULE	pid_sched;						// The IRON PID gain schedule
+		GUN_MODEL	gun_model;							// The Hot Air Gun model for the dead time compensation
 };
 
 #endif
@@ -14,8 +14,18 @@
 typedef	uint8_t	bool;
 #endif
 
+typedef enum { ADC_MISSED = 0, ADC_LATE, ADC_FULL, ADC_ERROR, ADC_REARM, ADC_CUT, ADC_SKIP, ADC_STAT_NUM } t_adc_stat;
+typedef enum { PWR_PEAK_W = 0, PWR_PEAK_A, PWR_IRON_CUT, PWR_GUN_CUT, PWR_STAT_NUM } t_pwr_stat;
+
 // Forward function declaration
-bool isACsine(void);
+bool 	 isACsine(void);
+uint32_t bootReadyTime(void);								// The time when the working mode started (ms since power on)
+uint32_t bootPowerTime(void);								// The time when the IRON was powered first (ms since power on)
+uint32_t adcStatistics(t_adc_stat stat);					// The number of ADC failures of given type
+void	 ironFastMode(bool fast);							// Run the IRON control loop at 100 Hz (fast) or 50 Hz
+void	 powerBudget(uint16_t watts);						// The total power limit of the IRON and the Hot Air Gun, 0 - no limit
+uint32_t powerStatistics(t_pwr_stat stat);					// The power budget statistics, see PWR_BUDGET
+void	 gunBurstMode(bool burst);							// Spread the Hot Air Gun power over TIM1 period, see BURST
 
 #ifdef __cplusplus
 extern "C" {
@@ -23,6 +33,7 @@ extern "C" {
 
 void setup(void);
 void loop(void);
+void controlTask(void);
 
 #ifdef __cplusplus
 }
@@ -9,6 +9,7 @@
 #include "main.h"
 #include "oled.h"
 #include "config.h"
+#include "prof.h"
 
 typedef enum { SCR_MODE_OFF = 0, SCR_MODE_IRON_ON,  SCR_MODE_IRON_STBY, SCR_MODE_GUN_ON } SCR_MODE;
 
@@ -29,17 +30,20 @@ class DSPL : public U8G2 {
 		void 		msgIdle(void);
 		void 		msgStandby(void);
 		void 		msgBoost(void);
+		void		msgReadyTime(uint16_t ds);				// Ready message with the time to ready (tenths of second)
 		void 		timeToOff(uint8_t time);
 		void 		tip(const char *tip_name);
 		void		fanSpeed(uint8_t pcnt);
+		void		coolTime(uint16_t secs);				// Show the Hot Air Gun time to cold instead of the tip name
 		void 		pidInit(void);
 		void		pidSetLowerAxisLabel(const char *label);
 		void 		pidModify(uint8_t index, uint16_t value);
 		void 		autoPidInfo(const char *message);
 		void		autoPidCurrentLoop(uint16_t loop, uint32_t period);
+		void		autoPidModel(uint16_t K, uint32_t T, uint32_t L);
 		void		pidPutData(int16_t temp, uint16_t disp);
 		void 		pidShowGraph(uint8_t pwr);
-		void 		pidShowMenu(uint16_t pid_k[3], uint8_t index);
+		void 		pidShowMenu(uint16_t pid_k[3], uint8_t index, const char *title);
 		void 		animateFan(uint8_t indx);
 		void		mainShow(uint16_t t_set, uint16_t t_cur, int16_t  t_amb, uint8_t p_applied,
 							bool is_celsius, bool tip_calibrated, uint16_t t_alter, uint8_t fan_index = 0, bool tilt_iron_used=false);
@@ -53,7 +57,10 @@ class DSPL : public U8G2 {
 		void 		menuItemShow(const char* title, const char* item, const char* value, bool modify);
 		void 		errorShow(void);
 		void		errorMessage(const char *msg);
-		void 		debugShow(bool gun_mode, uint16_t power, bool iron, bool gun, uint16_t data[4]);
+		void 		debugShow(bool gun_mode, uint16_t power, bool iron, bool gun, uint16_t data[4], uint16_t ac_freq, bool ac_lock);
+		void		debugProfile(ISR_PROF prof[], uint8_t size);
+		void		debugHistogram(uint8_t index, ISR_PROF *prof);
+		void		debugValues(const char *title, const char *names[], uint32_t values[], uint8_t size);
 		void 		showVersion(void);
 	private:
 		char      	msg_buff[8]			= {0};             // the buffer for the message in top right corner
@@ -7,18 +7,25 @@
  * The data in the EEPROM is addressed by chunks.
  * There are 128 chunks of 32 bytes in the EEPROM IC at24c32a.
  * First 64 chunks [0-63] are used to store configuration data.
- * One record per chunk as soon the configuration record can fit into one chunk.
+ * One record per chunk as soon the configuration record can fit into one chunk. The last chunk of the area [63] keeps
+ * the IRON PID gain schedule (see PID_SCHEDULE), the chunk [62] keeps the Hot Air Gun model (see GUN_MODEL),
+ * the configuration records rotate in chunks [0-61].
+ * The old firmware used chunks 62-63 for the configuration records as well. If one of them holds the newest record,
+ * the record is copied into the ring when the controller starts, before the chunk is taken.
  * To save EEPROM rewrite cycles, new record is written to the next free chunk, increasing record ID.
  * When the controller starts, it reads all the chunks in the configuration area and find the last record
  * that has the biggest record ID.
  *
  * Last 64 chunks [64-127] are used to store the tip configuration data.
- * As soon as tip configuration requires only 16 bytes, two records can fit to the chunk.
+ * As soon as tip configuration requires 32 bytes (with the tip PID coefficients), one record fits to the chunk.
  * Only active and calibrated tips are stored in this area.
  * When the controller starts, it reads all the chunks in the tip area and builds tip configuration table (tip_table, see config.c).
  * The tip_table tip_chunk_index field is the index of the tip in tip configuration area.
- * index = 0 means the first (of two) record in the first tip configuration chunk (64 chunk of the EEPROM).
- * index = 1 means the second record record in the first tip configuration chunk (64 chunk of the EEPROM).
+ * index = 0 means the record in the first tip configuration chunk (64 chunk of the EEPROM).
+ * The old firmware saved two 16-bytes tip records per chunk. Such a tip area is converted by migrateTipArea().
+ * The converted area is marked in the PID gain schedule record, so the area is not checked on the next start.
+ * If the old area keeps too many tips, it is not converted: the old records are read and written without
+ * the tip PID coefficients (see isOldTipArea()), the area can be converted when some tips are deactivated.
  *
  * For chunk manipulations two functions are used: readChunk() and writeChunk().
  * These functions read and write the EEPROM chunk from/to static data buffer.
@@ -44,24 +51,47 @@ class EEPROM {
 		bool 			saveRecord(RECORD* config_record);	// Modifies the record: increment the ID and calculate CRC
 		TIP_IO_STATUS 	loadTipData(TIP* tip, uint8_t tip_chunk_index);
 		TIP_IO_STATUS	saveTipData(TIP* tip, uint8_t tip_chunk_index);
+		bool			migrateTipArea(void);
+		bool			isOldTipArea(void)				{ return old_tips; }
 		void 			clearConfigArea(void);
+		bool			loadSchedule(PID_SCHEDULE* schedule);
+		bool			saveSchedule(PID_SCHEDULE* schedule);
+		bool			loadGunModel(GUN_MODEL* model);
+		bool			saveGunModel(GUN_MODEL* model);
 		void			forceReloadChunk(void)			{ chunk_in_data	= 65535; }
 	private:
 		bool 			readChunk(uint16_t chunk_index);
 		bool 			writeChunk(uint16_t chunk_index);
 		uint8_t 		CFG_checkSum(RECORD* cfg, bool write);
 		uint8_t 		TIP_checkSum(TIP* tip, bool write);
+		bool			TIP_PIDcheckSum(TIP* tip, bool write);
+		uint16_t		dataCRC(uint8_t* d, uint8_t size);
 		uint16_t 		requiredTipSpace(void);
+		bool			convertTipArea(uint8_t *rec, uint8_t *rec_chunk, uint16_t n);
+		bool			markTipArea(void);
+		void			moveOldRecord(uint32_t max_rec_ID);
+		bool			loadSysRecord(uint16_t chunk, uint16_t ID, uint8_t* rec, uint8_t size);
+		bool			saveSysRecord(uint16_t chunk, uint16_t ID, uint8_t* rec, uint8_t size);
 		I2C_HandleTypeDef* 	hi2c	= 0;
 		bool		can_write				= false;	// The flag indicates that data can be saved to the EEPROM
+		bool		old_tips				= false;	// The tip area keeps two old tip records per chunk
 		uint16_t	r_chunk					= 0;		// Chunk number of the correct record in EEPROM to be read
 		uint16_t	w_chunk					= 0;		// Chunk number in the EEPROM to start write new record
 		uint8_t  	data[eeprom_chunk_size];			// Data buffer for one EEPROM chunk
 		uint16_t	chunk_in_data			= 65535;	// Current chunk number in the data buffer [0-(eeprom_chunks-1)]. For caching
 		const uint16_t		eeprom_chunks 	= 128;		// The number of chunks in my EEPROM IC
 		const uint16_t  	eeprom_address 	= 0x50;		// AT24C32 EEPROM IC address on the I2C bus
-		const uint16_t		cfg_chunks		= 64;		// The space of EEPROM (in chunks) dedicated to the configuration data
+		const uint16_t		cfg_area		= 64;		// The configuration area of the EEPROM (in chunks)
+		const uint16_t		cfg_chunks		= 62;		// The space of EEPROM (in chunks) dedicated to the configuration records
+		const uint16_t		model_chunk		= 62;		// The chunk of the Hot Air Gun model
+		const uint16_t		model_ID		= 0x4D47;	// The Hot Air Gun model signature, "GM"
+		const uint16_t		sched_chunk		= 63;		// The chunk of the PID gain schedule
+		const uint16_t		sched_ID		= 0x5350;	// The PID gain schedule signature, "PS"
 		const uint16_t		tip_chunks		= 64;		// The maximum number of chunks used to store the configured tips
+		const uint16_t		tip_pid_ID		= 0x5054;	// The tip PID signature, "TP"
+		const uint8_t		tip_rec_new		= 0x80;		// The flags of the tip record chunk, see convertTipArea()
+		const uint8_t		tip_rec_done	= 0x40;
+		const uint8_t		tip_rec_mask	= 0x3F;
 };
 
 #endif
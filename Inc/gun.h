@@ -11,6 +11,36 @@
 #include "stat.h"
 #include "pid.h"
 #include "tools.h"
+#include "cfgtypes.h"
+
+/*
+ * Burst fire of the Hot Air Gun heater: the power (number of the half-waves in TIM1 period) is spread evenly over the
+ * TIM1 period by sigma-delta (Bresenham) scheduling instead of one contiguous block of the half-waves.
+ * The decision is made for the whole AC periods (pairs of the half-waves), so the heater does not draw DC current.
+ * The spread half-waves modulate the mains voltage at about N/2 Hz, where the lamp flicker is the most visible.
+ * The power is spread only where the weighted flicker is not worse than the contiguous block: near 0, 50 and
+ * 100 half-waves (see test/burst_sim.cpp), otherwise the contiguous block is fired as in the PWM mode
+ */
+class BURST {
+	public:
+		BURST(void)											{ }
+		void		reset(void)								{ acc = 0; on = false; next = 0; block = 0; spread = false;	}
+		void		setPower(uint16_t half_waves)			{ power = half_waves;							}
+		bool		fire(uint16_t half_wave);				// Whether the heater should be on in the half-wave (TIM1 counter)
+		bool		isOn(void)								{ return on;									}
+		bool		willFire(uint8_t n);					// Whether the heater would be on in the next n half-waves
+		static bool	isSpread(uint16_t half_waves);			// Whether the power is spread in burst fire mode
+	private:
+		volatile	uint16_t	acc		= 0;				// The sigma-delta accumulator
+		volatile	uint16_t	power	= 0;				// The half-waves to be fired in the period
+		volatile	uint16_t	next	= 0;				// The next half-wave index
+		volatile	bool		on		= false;			// The heater is on in current AC period
+		volatile	uint16_t	block	= 0;				// The contiguous block of the half-waves in this period
+		volatile	bool		spread	= false;			// The power is spread in this period
+		static const uint16_t	period		= 100;			// TIM1 period, the half-waves
+		static const uint16_t	spread_edge	= 6;			// Spread 3..6 and 94..97 half-waves
+		static const uint16_t	spread_mid	= 2;			// Spread 48..52 half-waves
+};
 
 class HOTGUN_HW {
 	public:
@@ -18,6 +48,7 @@ class HOTGUN_HW {
 		void		init(void);
 		bool 		isGunReedOpen(void)						{ return sw_gun.status();					}	// TRUE if switch is open
 		bool 		isGunConnected(void) 					{ return c_fan.status();					}
+		bool		isReady(void);							// The REED switch and the connection (if fan is powered) have been read
 		int32_t		fanCurrent(void)						{ return c_fan.read();						}
 		void		updateFanCurrent(uint16_t value)		{ c_fan.update(value);						}
 		void		checkSWStatus(void);
@@ -36,23 +67,95 @@ class HOTGUN_HW {
         const		uint32_t	relay_activate	= 1;		// The relay activation delay (loops of TIM1, 1 time per second)
 };
 
-class HOTGUN : public HOTGUN_HW, public PID {
+/*
+ * Smith predictor of the Hot Air Gun temperature, first order plus dead time (FOPDT) model:
+ * Tm(n+1) = Tm(n) + (K*u(n-L) - Tm(n)) / T, the time unit is HOTGUN::power() call period (TIM1 period, about 1 second)
+ * Two models are calculated: with and without the dead time. The difference between them is added to the measured
+ * temperature, so the PID sees the temperature that the heater will have after the dead time.
+ * There is no default model: it is identified by the PID autotune (see MAUTOPID) and loaded from the EEPROM.
+ * Without the model (K == 0) there is no correction. With the autotune coefficients the predictor shortens
+ * the settle time; it also allows higher coefficients without the overshoot, see test/smith_sim.cpp
+ */
+class SMITH {
+	public:
+		SMITH(void)											{ reset(); }
+		void		model(uint16_t k, uint16_t t, uint8_t l);	// K (internal units per power unit * 16), T and L (periods)
+		void		reset(void);
+		int32_t		correction(void)						{ return K?((t_model - t_delayed + 128) >> 8):0;	}
+		bool		hasModel(void)							{ return K > 0;								}
+		void		update(uint16_t power);					// Apply the power to the model
+		static const uint8_t	max_delay	= 15;		// Maximum dead time of the model (periods)
+	private:
+		int32_t		t_model			= 0;					// The model temperature without dead time (internal units * 256)
+		int32_t		t_delayed		= 0;					// The model temperature with dead time (internal units * 256)
+		uint8_t		pwr[max_delay+1];						// The power history (dead time buffer)
+		uint8_t		index			= 0;
+		uint16_t	K				= 0;					// The model gain (internal units per power unit * 16), 0 - no model
+		uint16_t	T				= 1;					// The model time constant (periods)
+		uint8_t		L				= 0;					// The model dead time (periods)
+};
+
+/*
+ * The fan speed regulator. The airflow is estimated by the fan current. The reference current is learned once per
+ * fan speed: the first time the fan settles at the speed out of the learned range, the current is saved as
+ * the new reference point (the nozzle is supposed to be clear). The reference for the other speeds is interpolated.
+ * The points are saved in the EEPROM with the Hot Air Gun model and cleared by the user after the nozzle is cleaned.
+ * The fan PWM is corrected to keep the reference current, so the airflow does not drift when the fan supply voltage
+ * changes or the nozzle gets dirty. The current far from the reference means the nozzle is blocked or the fan
+ * is stalled. Called once per TIM1 period
+ */
+class FAN_REG {
+	public:
+		FAN_REG(void)										{ clearReference(); ref_changed = false;		}
+		void		start(uint16_t preset);					// Start regulation of new preset fan speed
+		uint16_t	pwm(int32_t current);					// The fan PWM for the measured fan current
+		bool		isFailed(void)							{ return failed;								}
+		void		loadReference(const uint16_t pwm[FAN_REF_POINTS], const uint16_t cur[FAN_REF_POINTS]);
+		void		dumpReference(uint16_t pwm[FAN_REF_POINTS], uint16_t cur[FAN_REF_POINTS]);
+		void		clearReference(void);
+		bool		referenceChanged(void)					{ bool c = ref_changed; ref_changed = false; return c;	}
+		uint8_t		referencePoints(void);					// The number of the learned points
+	private:
+		int32_t		reference(uint16_t speed);				// The reference current at the speed, 0 - should be learned
+		volatile	uint16_t	preset		= 0;			// The preset fan speed (PWM)
+		volatile	int32_t		out			= 0;			// The regulated fan PWM * 16
+		volatile	int32_t		ref			= 0;			// The reference fan current
+		volatile	uint8_t		settle		= 0;			// Periods to wait till the fan settles to learn the reference
+		volatile	uint8_t		fault_cnt	= 0;			// Successive periods of wrong current
+		volatile	bool		failed		= false;
+		volatile	uint16_t	ref_pwm[FAN_REF_POINTS];	// The learned reference points: the fan speed
+		volatile	uint16_t	ref_cur[FAN_REF_POINTS];	// and the current, 0 - the point is free
+		volatile	bool		ref_changed	= false;		// The new point was learned, should be saved
+		const uint8_t	settle_periods		= 4;
+		const uint16_t	learn_dist			= 100;			// Learn new point if the nearest one is farther (PWM)
+		const uint8_t	fault_periods		= 5;
+		const uint8_t	min_current_pcnt	= 50;			// The minimum current (percents of the reference): blocked nozzle
+		const uint16_t	max_current_pcnt	= 200;			// The maximum current (percents of the reference): stalled fan
+		const uint16_t	max_fan				= 1999;
+};
+
+typedef PID_ENGINE<13, 0, 99> GUN_PID;					// The output range is the Hot Air Gun power range, see max_power
+
+class HOTGUN : public HOTGUN_HW, public GUN_PID, public PIDTUNE {
     public:
-		typedef enum { POWER_OFF, POWER_ON, POWER_FIXED, POWER_COOLING } PowerMode;
-        HOTGUN(void) : h_power(hot_gun_hist_length), h_temp(hot_gun_hist_length) { }
+		typedef enum { POWER_OFF, POWER_ON, POWER_FIXED, POWER_COOLING, POWER_PID_TUNE } PowerMode;
+        HOTGUN(void) : h_power(hot_gun_hist_length), h_temp(hot_gun_hist_length), guard(99, 1, 768, 5, 15, 300, 3) { }
         void        init(void);
-		bool		isOn(void)								{ return (mode == POWER_ON || mode == POWER_FIXED); }
+		bool		isOn(void)								{ return (mode == POWER_ON || mode == POWER_FIXED || mode == POWER_PID_TUNE); }
 		uint16_t	presetTemp(void)						{ return temp_set; 								}
 		uint16_t	presetFan(void)							{ return fan_speed;								}
 		uint16_t 	averageTemp(void)                  		{ return h_temp.read(); 						}
         uint8_t     getMaxFixedPower(void)					{ return max_fix_power; 						}
+        uint8_t     getMaxPower(void)						{ return max_power; 							}
         bool		isCold(void)							{ return h_temp.read() < temp_gun_cold;			}
         bool		isFanWorking(void)						{ return (fanSpeed() >= min_fan_speed);			}
         uint16_t	maxFanSpeed(void)						{ return max_fan_speed;							}
         uint16_t	pwrDispersion(void)              		{ return d_power.read(); 						}
+		uint16_t	avgPower(void)							{ return h_power.read();						}
 		void		setTemp(uint16_t temp)					{ temp_set	= constrain(temp, 0, int_temp_max);	}
 		void		updateTemp(uint16_t value)				{ if (isGunConnected()) h_temp.update(value);	}
-		void		setFan(uint16_t fan)					{ fan_speed = constrain(fan, min_working_fan, max_fan_speed);	}
+		void		setFan(uint16_t fan);
+		bool		isFanFailed(void)						{ return fan_reg.isFailed();					}	// Blocked nozzle or stalled fan
 		void		fanFixed(uint16_t fan)					{ TIM2->CCR2 = constrain(fan, 0, max_fan_speed);}
 		uint16_t	alternateTemp(void);					// Current temperature or 0 if cold
         void        switchPower(bool On);
@@ -60,10 +163,24 @@ class HOTGUN : public HOTGUN_HW, public PID {
 		uint16_t	appliedPower(void);
 		uint16_t	fanSpeed(void);							// Fan supplied to Fan, PWM duty
         void        fixPower(uint8_t Power);				// Set the specified power to the the hot gun
+		void		autoTunePID(uint16_t base_pwr, uint16_t delta_power, uint16_t base_temp, uint16_t temp, uint16_t delta_low = 0);
 		uint8_t		presetFanPcnt(void);
 		uint16_t    power(void);							// Required Hot Air Gun power to keep the preset temperature
+		void		usePredictor(bool use)					{ predictor = use; smith.reset();				}
+		void		predictorModel(uint16_t k, uint16_t t, uint8_t l)	{ smith.model(k, t, l);				}
+		bool		hasPredictorModel(void)					{ return smith.hasModel();						}
+		void		loadFanReference(const uint16_t pwm[FAN_REF_POINTS], const uint16_t cur[FAN_REF_POINTS])	{ fan_reg.loadReference(pwm, cur);	}
+		void		dumpFanReference(uint16_t pwm[FAN_REF_POINTS], uint16_t cur[FAN_REF_POINTS])	{ fan_reg.dumpReference(pwm, cur);	}
+		void		clearFanReference(void)					{ fan_reg.clearReference();						}	// The nozzle is clear, learn again
+		bool		fanReferenceChanged(void)				{ return fan_reg.referenceChanged();			}
+		uint8_t		fanReferencePoints(void)				{ return fan_reg.referencePoints();				}
+		uint16_t	timeToCold(void);						// Predicted time to cool the Hot Air Gun down (seconds), 0 if unknown
+		THERMAL_GUARD::t_fault	thermalFault(void)		{ return guard.fault();							}
+		void		clearFault(void)						{ guard.clear();								}
     private:
 		void		shutdown(void);
+		uint16_t	coolFan(uint16_t t);					// The fan speed to cool the Hot Air Gun down fast and safe
+		uint32_t	coolTime(int32_t t);					// Predicted time to cool down from the temperature (ms), 0 if unknown
 		PowerMode	mode				= POWER_OFF;
 		uint8_t    	fix_power			= 0;				// Fixed power value of the Hot Air Gun (or zero if off)
 		bool		chill				= false;			// Chill the Hot Air gun if it is over heating
@@ -74,6 +191,18 @@ class HOTGUN : public HOTGUN_HW, public PID {
 		EMP_AVERAGE	h_temp;									// Exponential average of Hot Air Gun temperature
 		EMP_AVERAGE	d_power;								// Exponential average of power dispersion
 		EMP_AVERAGE	zero_temp;								// Exponential average of minimum (zero) temperature
+		SMITH		smith;									// Dead time compensation
+		FAN_REG		fan_reg;								// Keep the airflow by the fan current
+		THERMAL_GUARD	guard;								// The heater and sensor model check
+		EMP_AVERAGE	cool_k;									// The cooling model: temperature drop per period / (temperature * fan) * 2**32
+		uint16_t	cool_prev			= 0;				// The temperature in previous period of cooling, 0 if not cooling
+		uint8_t		cool_skip			= 0;				// Periods to wait before learning the cooling model
+		bool		cool_fresh			= false;			// The cooling model was not updated in this cooldown yet
+		bool		cool_model			= false;			// The cooling model has been learned
+		bool		cool_lost			= false;			// The Hot Air Gun was disconnected while cooling
+		uint32_t	last_power_ms		= 0;				// The time of previous power() call
+		volatile	uint16_t	period_ms		= 1000;		// The power() call period (TIM1 period, ms)
+		volatile	bool		predictor		= false;	// Use Smith predictor
         const       uint8_t     max_fix_power 	= 70;
 		const		uint8_t		max_power		= 99;
 		const		uint16_t	min_fan_speed	= 600;
@@ -82,6 +211,13 @@ class HOTGUN : public HOTGUN_HW, public PID {
 		const		uint16_t	min_working_fan	= 800;
         const       uint16_t    temp_gun_cold   = 100;		// The temperature of the cold Hot Air Gun
         const		uint32_t	fan_off_timeout	= 5*60*1000;// The timeout to turn the fan off in cooling mode
+        const		uint32_t	min_fan_off		= 30000;	// The minimal time to turn the fan off when disconnected (ms)
+        const		uint8_t		cool_k_len		= 8;		// Exponential average coefficient of the cooling model
+        const		uint8_t		cool_k_min		= 3;		// Minimum updates of the cooling model to be used
+        const		uint16_t	max_cool_grad	= 12;		// Maximum safe cooling rate of the heater (internal units per period, about 3.5 Celsius/s), see test/cooling_sim.cpp
+        const		uint8_t		cool_skip_len	= 8;		// The sensor lags the heater when the cooling starts (periods)
+        const		uint16_t	max_cool_step	= 50;		// Maximum fan speed increment per period while cooling
+        const		uint16_t	guard_heating	= 100;		// The temperature below the preset one to check the heater is working
 };
 
 #endif
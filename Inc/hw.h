@@ -17,6 +17,7 @@
 #include "encoder.h"
 #include "display.h"
 #include "config.h"
+#include "acpll.h"
 
 extern I2C_HandleTypeDef 	hi2c1;
 
@@ -44,6 +45,7 @@ class HW {
 		HOTGUN		hotgun;
 		BUZZER		buzz;
 		SCRSAVER	scrsaver;
+		AC_PLL		mains;
 };
 
 #endif
@@ -10,6 +10,7 @@
 
 #include "pid.h"
 #include "stat.h"
+#include "cfgtypes.h"
 
 class IRON_HW {
 	public:
@@ -17,50 +18,76 @@ class IRON_HW {
 		void		init(void);
 		bool 		isIronConnected(void) 					{ return c_iron.status();						}
 		uint16_t	ironCurrent(void)						{ return c_iron.read();							}	// Used in debug mode only
-		void		updateAmbient(uint32_t value)			{ t_amb.update(value);							}
+		void		updateAmbient(uint32_t value);
 		void		updateIronCurrent(uint16_t value)		{ c_iron.update(value);							}
-		int32_t		tempShortAverage(int32_t t)				{ return t_iron_short.average(t);				}
-		void		resetShortTemp(void)					{ t_iron_short.reset();							}
+		bool		isSwapped(void)							{ return c_iron.changed();						}	// The IRON connection status changed
+		int32_t		tempEstimate(int32_t t, int32_t p)		{ t_iron.update(t, p); return t_iron.read();	}
+		int32_t		tempRate(void)							{ return (t_iron.rate() * 50 + 128) >> 8;		}	// Internal units per second
+		int32_t		tempGain(void)							{ return t_iron.gain();							}	// Rate per power unit per 20 ms * 65536
+		bool		isGainLearned(void)						{ return t_iron.gainUpdates() >= min_gain_updates;	}
+		void		resetShortTemp(void)					{ t_iron.reset();								}
+		void		setRate(uint8_t shift)					{ t_iron.rescale(shift);						}
 		uint16_t	ambientInternal(void)					{ return t_amb.read();							}
 		bool		noAmbientSensor(void)					{ return t_amb.read() >= max_ambient_value;		}
 		uint16_t	tiltInternal(void)						{ return sw_iron.read();						}
 		void		checkSWStatus(void);					// Check TILT switch status
+		bool		isReady(void);							// All the IRON sensors have been read
 		bool 		isIronTiltSwitch(bool reed);			// REED switch: TRUE if switch is shorten; else: TRUE if status has been changed
 		int32_t		ambientTemp(void);
 	private:
 		uint32_t	check_sw				= 0;			// Time when check tilt switch status (ms)
-		EMP_AVERAGE t_iron_short;							// Exponential average of the IRON temperature (short period)
+		ALPHA_BETA	t_iron;									// The IRON temperature estimation
 		EMP_AVERAGE t_amb;									// Exponential average of the ambient temperature
 		SWITCH 		c_iron;									// Iron is connected switch
 		SWITCH 		sw_iron;								// IRON tilt switch
 		const uint8_t	ambient_emp_coeff	= 10;			// Exponential average coefficient for ambient temperature
-		const uint8_t	iron_emp_coeff		= 8;			// Exponential average coefficient for IRON temperature
 		const uint16_t	iron_off_value		= 500;
 		const uint16_t	iron_on_value		= 1000;
 		const uint8_t	iron_sw_len			= 3;			// Exponential coefficient of current through the IRON switch
+		const uint8_t	iron_sw_fast		= 2;			// Successive current checks to detect the tip is removed or inserted
 		const uint8_t	sw_off_value		= 14;
 		const uint8_t	sw_on_value			= 20;
 		const uint8_t	sw_avg_len			= 5;
 		const uint8_t	sw_tilt_len			= 2;
 		const uint32_t	check_sw_period 	= 100;			// Tilt switch check period, ms
 		const uint16_t	max_ambient_value	= 3900;			// About -30 degrees. If the soldering IRON disconnected completely, "ambient" value is greater than this
+		const uint8_t	min_gain_updates	= 4;			// The power to rate gain is trusted after this number of updates
 };
 
-class IRON : public IRON_HW, public PID, public PIDTUNE {
+/*
+ * The controller state of the removed tip. When the warm tip is inserted back shortly, the control resumes from this state
+ */
+typedef struct s_tip_state TIP_STATE;
+struct s_tip_state {
+	uint32_t	ms;											// The time when the tip was removed, 0 if the slot is free
+	PID_STATE	pid;
+	uint16_t	temp;										// The tip temperature when it was removed
+	uint16_t	temp_set;									// The preset temperature
+	uint8_t		tip;										// The tip index
+};
+
+typedef PID_ENGINE<11, 0, 1999> IRON_PID;				// The output range is the IRON power range, see max_power
+
+class IRON : public IRON_HW, public IRON_PID, public PIDTUNE {
 	public:
 	typedef enum { POWER_OFF, POWER_ON, POWER_FIXED, POWER_COOLING, POWER_PID_TUNE } PowerMode;
-		IRON(void) 											{ }
+		IRON(void) : guard(1999, 3, 256, 25, 150, 400, 25)		{ }
 		void		init(void);
 		void		switchPower(bool On);
 		void		autoTunePID(uint16_t base_pwr, uint16_t delta_power, uint16_t base_temp, uint16_t temp);
 		bool		isOn(void)								{ return (mode == POWER_ON); }
-		uint16_t 	temp(void)								{ return temp_curr; }
+		void		wakeBoost(void)							{ boost_req = true; }	// Heat up at full power when switched on next time
+		bool		isBoosting(void)						{ return boost; }
+		void		setBoostLag(uint8_t lag)				{ boost_lag = (lag <= boost_lag_max)?lag:0; }	// Load the tip heat lag (20 ms periods), 0 - not learned
+		uint8_t		boostLag(void)							{ return boost_lag; }	// The tip heat lag identified by the boost
+		uint16_t 	temp(void)								{ return temp_curr; }	// The estimated temperature, see ALPHA_BETA
 		uint16_t	presetTemp(void)						{ return temp_set; }
 		uint16_t	averageTemp(void)						{ return h_temp.read(); }
 		uint16_t 	tmpDispersion(void)						{ return d_temp.read(); }
 		uint16_t	pwrDispersion(void)              		{ return d_power.read(); }
 		uint16_t    getMaxFixedPower(void)             		{ return max_fix_power; }
 		bool		isCold(void)							{ return (mode == POWER_OFF); }
+		bool		isSteady(void);							// The temperature is stable near the preset one
 		uint16_t	alternateTemp(void);					// Current temperature or 0 if cold
 		void     	setTemp(uint16_t t);					// Set the temperature to be kept (internal units)
 		uint16_t    avgPower(void);							// Average applied power
@@ -70,21 +97,64 @@ class IRON : public IRON_HW, public PID, public PIDTUNE {
 		uint16_t	power(int32_t t);						// Required power to keep preset temperature
 		void		reset(void);							// Iron is disconnected, clear the temp history
 		void        lowPowerMode(uint16_t t);				// Activate low power mode (preset temp.) To disable, use switchPower(true)
+		void		setRate(uint8_t shift);					// The power() is called 2**shift times faster than 50 Hz
+		void		setFeedForward(uint8_t k);				// Load the tip feedforward coefficient, restart learning
+		uint8_t		learnedFeedForward(void);				// The feedforward coefficient learned in steady state or 0
+		THERMAL_GUARD::t_fault	thermalFault(void)		{ return guard.fault();	}
+		void		clearFault(void)						{ guard.clear();		}
+		void		selectTip(uint8_t index);				// The tip has been changed, look for its saved state on insertion
+		void		hotSwap(bool connected);				// The tip was removed or inserted, save or restore its state
 	private:
+		void		resume(int32_t t);						// Restore the state of the inserted tip or restart the control
+		void		identifyLag(int32_t t, int32_t applied);	// Identify the tip heat lag by the boost power step
+		static const uint8_t	tip_slots	= 3;			// The number of the removed tips to be remembered
+		TIP_STATE	tip_state[tip_slots];					// The state of recently removed tips
+		uint8_t		tip_id				= 0xFF;				// The index of the tip in use
+		volatile	bool resume_check	= false;			// The tip was inserted, check its temperature in power()
+		uint16_t	resumed_set			= 0;				// The preset temperature of the resumed PID state, see switchPower()
 		uint16_t 	temp_set			= 0;				// The temperature that should be kept
 		uint16_t	temp_low			= 0;				// The temperature in low power mode (if not zero)
 		uint16_t    fix_power			= 0;				// Fixed power value of the IRON (or zero if off)
 		volatile 	PowerMode	mode	= POWER_OFF;		// Working mode of the IRON
 		volatile 	bool chill			= false;			// Whether the IRON should be cooled (preset temp is lower than current)
+		volatile	bool boost_req		= false;			// The IRON was picked up, boost when powered on
+		volatile	bool boost			= false;			// Heating up at full power, see power()
+		uint32_t	boost_end			= 0;				// The boost time limit (ms)
+		uint32_t	boost_start			= 0;				// The time when the boost power was applied (ms), 0 - lag identified
+		int32_t		boost_t0			= 0;				// The temperature at the boost start
+		int32_t		boost_r0			= 0;				// The temperature rate at the boost start (internal units per second)
+		int32_t		boost_t1			= 0;				// The temperature at the start of the rate measurement
+		int32_t		boost_e1			= 0;				// The time from the boost start to the rate measurement (ms), 0 - not started
+		int32_t		boost_p0			= 0;				// The power applied before the boost
+		int32_t		boost_psum			= 0;				// Summary power applied by the boost
+		uint16_t	boost_n				= 0;				// Number of the boost periods
+		uint8_t		boost_lag			= 0;				// The tip heat lag (20 ms periods), 0 - not learned
 		volatile	uint16_t	temp_curr = 0;				// The actual IRON temperature
 		EMP_AVERAGE h_power;								// Exponential average of applied power
 		EMP_AVERAGE	h_temp;									// Exponential average of temperature
 		EMP_AVERAGE d_power;								// Exponential average of power math dispersion
 		EMP_AVERAGE d_temp;									// Exponential temperature math dispersion
+		EMP_AVERAGE	ff_learn;								// Exponential average of the feedforward coefficient in steady state
+		THERMAL_GUARD	guard;								// The heater and sensor model check
+		volatile	uint8_t		ff_k	= 0;				// The feedforward coefficient: power = ff_k * temp / 2**ff_shift
 		const uint16_t	max_power      		= 1999;			// Maximum power to the IRON
 		const uint16_t	max_fix_power  		= 1000;			// Maximum power in fixed power mode
 		const uint8_t	ec	   				= 20;			// Exponential average coefficient
 		const uint16_t	iron_cold			= 100;			// The internal temperature when the IRON is cold
+		const uint16_t	steady_temp			= 16;			// Maximum difference between the average and preset temperatures in steady state
+		const uint16_t	steady_disp			= 16;			// Maximum temperature dispersion in steady state
+		const uint8_t	ff_shift			= 7;			// The feedforward coefficient denominator power of 2
+		const uint8_t	ff_max				= TIP_FF_MASK >> TIP_FF_SHIFT;	// Maximum feedforward coefficient to be saved in the tip mask
+		const uint8_t	ff_emp_coeff		= 64;			// Exponential average coefficient of the feedforward coefficient
+		const uint16_t	boost_min			= 60;			// Minimum temperature to be gained by the boost (internal units)
+		const uint16_t	boost_lead			= 600;			// The heat lag of the tip to predict the temperature after the boost (ms), while not learned
+		const uint16_t	boost_max_time		= 20000;		// Maximum boost time (ms)
+		const uint16_t	boost_ident_time	= 2000;			// The time to identify the heat lag after the boost start (ms)
+		const int32_t	boost_min_rate		= 100;			// Minimum rate gained by the boost to identify the heat lag (internal units per second)
+		const uint8_t	boost_lag_max		= 40;			// Maximum heat lag (20 ms periods), less than a half of boost_ident_time
+		const uint16_t	guard_heating		= 200;			// The temperature below the preset one to check the heater is working
+		const uint16_t	resume_time			= 30000;		// The state of the removed tip is valid for this time (ms)
+		const uint16_t	resume_temp			= 200;			// Maximum difference between the saved and inserted tip temperatures
 };
 
 #endif
@@ -19,6 +19,7 @@
 #include "config.h"
 #include "stat.h"
 #include "hw.h"
+#include "prof.h"
 
 class MODE {
 	public:
@@ -58,6 +59,7 @@ class MSTBY_IRON : public MODE {
 		bool			used			= false;			// Whether the IRON was used (was hot)
 		bool			cool_notified	= 0;				// Whether there was cold notification played
 		bool			no_handle		= false;			// Whether soldering iron handle disconnected (no ambient sensor)
+		bool			cool_shown		= false;			// Whether the Hot Air Gun time to cold is shown instead of the tip name
 		uint16_t 		old_temp_set	= 0;
 };
 
@@ -80,9 +82,11 @@ class MWORK_IRON : public MODE {
 		bool      		ready			= false;			// Whether the IRON have reached the preset temperature
 		uint32_t		ready_clear		= 0;				// Time when to clean 'Ready' message
 		uint32_t		lowpower_time	= 0;				// Time when switch to standby power mode
+		uint32_t		pickup_time		= 0;				// Time when the IRON was picked up in low power mode to measure the time to ready
 		uint16_t 		old_temp_set	= 0;
 		const uint16_t	period			= 500;				// Redraw display period (ms)
 		const uint8_t	ec				= 5;				// The exponential average coefficient
+		const int16_t	ready_rate		= 8;				// Maximum temperature rate (internal units per second) to be ready
 };
 
 //-------------------- The iron low power mode, decrease iron temperature --------
@@ -154,24 +158,26 @@ class MMENU : public MODE {
 		bool		keep_iron		= false;				// Keep the iron working While in Hot Air Gun Mode
 		bool		reed			= false;				// IRON switch type: reed/tilt
 		bool		temp_step		= false;				// The preset temperature step (1/5)
+		bool		fast_iron		= false;				// The IRON control loop rate: 100 Hz (true) or 50 Hz
 		uint8_t		set_param		= 0;					// The index of the modifying parameter
 		uint8_t		mode_menu_item 	= 1;					// Save active menu element index to return back later
 		// When new menu item added, the m_len, in_place_start, in_place_end, tip_calib_menu constants should be adjusted
-		uint8_t		m_len			= 19;					// The menu length
-		const char* menu_name[19] = {
+		uint8_t		m_len			= 20;					// The menu length
+		const char* menu_name[20] = {
 			"boost setup",
 			"units",
 			"buzzer",
 			"keep iron",
 			"switch type",
 			"temp. step",
-			"auto off",										// #6 First parameter that can be modified in-place
+			"iron rate",
+			"auto off",										// #7 First parameter that can be modified in-place
 			"standby temp",
 			"standby time",
-			"screen saver",									// #9 Last parameter that can be modified in-place
+			"screen saver",									// #10 Last parameter that can be modified in-place
 			"save",
 			"cancel",
-			"calibrate tip",								// #12 Menu item to start menu when the tip is not calibrated
+			"calibrate tip",								// #13 Menu item to start menu when the tip is not calibrated
 			"activate tips",
 			"tune iron",
 			"gun menu",
@@ -179,9 +185,9 @@ class MMENU : public MODE {
 			"tune iron PID",
 			"about"
 		};
-		const uint8_t	in_place_start	= 6;				// See the menu names. Index of the first parameter that can be changed inside menu
-		const uint8_t	in_place_end	= 9;				// See the menu names. Index of the last parameter that can be changed inside menu
-		const uint8_t	tip_calib_menu	= 12;				// See the menu names. Index of 'calibrate tip' menu
+		const uint8_t	in_place_start	= 7;				// See the menu names. Index of the first parameter that can be changed inside menu
+		const uint8_t	in_place_end	= 10;				// See the menu names. Index of the last parameter that can be changed inside menu
+		const uint8_t	tip_calib_menu	= 13;				// See the menu names. Index of 'calibrate tip' menu
 		const uint16_t	min_standby_C	= 120;				// Minimum standby temperature, Celsius
 };
 
@@ -284,11 +290,41 @@ class MTPID : public MODE {
 		uint32_t	data_update	= 0;						// When read the data from the sensors (ms)
 		uint32_t	temp_setready_ms	= 0;				// The time in ms when we should check the temperature is ready
 		uint8_t		data_index	= 0;						// Active coefficient
+		uint8_t		last_item	= 2;						// The last menu item: Kd or the temperature band (title)
+		uint8_t		band		= 0;						// The IRON temperature band + 1, tip_set or 0 for the main coefficients
+		const uint8_t	tip_set	= PID_BANDS+1;				// The IRON PID coefficients of the current tip
 		bool        modify		= 0;						// Whether is modifying value of coefficient
 		bool		on			= 0;						// Whether the IRON is turned on
 		uint16_t 	old_index 	= 3;
 };
 
+//---------------------- The Hot Air Gun PID autotune mode (relay method) --------
+class MAUTOPID : public MODE {
+	public:
+		MAUTOPID(HW *pCore) : MODE(pCore)					{ }
+		virtual void	init(void);
+		virtual MODE*	loop(void);
+	private:
+		typedef enum { TUNE_HEAT, TUNE_RELAY, TUNE_CHECK } TunePhase;
+		MODE*		failed(void);
+		TunePhase	phase			= TUNE_HEAT;
+		uint32_t	check_ms		= 0;					// Time in ms when to start checking the Hot Air Gun is connected
+		uint32_t	stable_ms		= 0;					// Time in ms when the temperature became stable (or 0)
+		uint32_t	phase_end		= 0;					// The phase timeout (ms)
+		uint16_t	delta_power		= 0;					// The relay power amplitude (upper), the lower one is a half
+		uint16_t	old_loops		= 0;
+		uint16_t	model_K			= 0;					// The identified model, the times are in TIM1 periods, see SMITH
+		uint16_t	model_T			= 0;
+		uint8_t		model_L			= 0;
+		const uint16_t	tune_temp		= 1200;				// 'Middle' temperature, see MTPID
+		const uint8_t	tune_hyst		= 4;				// The relay hysteresis (internal units)
+		const uint8_t	stable_diff		= 20;				// The temperature is stable within this range
+		const uint8_t	tune_loops		= 8;				// Number of the relay oscillations to be measured
+		const uint32_t	stable_time		= 30000;			// The temperature should be stable before the relay is started (ms)
+		const uint32_t	heat_timeout	= 600000;			// Maximum time to reach the stable temperature (ms)
+		const uint32_t	relay_timeout	= 1200000;			// Maximum time of the relay oscillations (ms)
+};
+
 //---------------------- The Hot Air Gun main working mode -----------------------
 class MWORK_GUN : public MODE, SCRSAVER {
 	public:
@@ -312,21 +348,29 @@ class MWORK_GUN : public MODE, SCRSAVER {
 //---------------------- Hot Air Gun setup menu ----------------------------------
 class MENU_GUN : public MODE {
 	public:
-		MENU_GUN(HW* pCore, MODE* calib, MODE* pot_tune, MODE* pid_tune);
+		MENU_GUN(HW* pCore, MODE* calib, MODE* pot_tune, MODE* pid_tune, MODE* auto_pid);
 		virtual void	init(void);
 		virtual MODE*	loop(void);
 	private:
 		MODE*			mode_calibrate;
 		MODE*			mode_tune;
 		MODE*			mode_pid;
-		uint8_t  		old_item	= 5;
-		const char* menu_list[5] = {
+		MODE*			mode_auto_pid;
+		uint8_t  		old_item	= 10;
+		const char* menu_list[10] = {
 			"calibrate",
 			"tune gun",
 			"tune gun PID",
+			"auto PID",
+			"predictor",
+			"power limit",
+			"burst fire",
+			"airflow",
 			"clear",
 			"exit"
 		};
+		const uint16_t	min_budget	= 300;					// The power limit setup range (watts)
+		const uint16_t	max_budget	= 1500;
 };
 
 //---------------------- The Fail mode: display error message --------------------
@@ -354,6 +398,13 @@ class MDEBUG : public MODE {
 	private:
 		uint16_t		old_power 		= 0;				// Old encoder value
 		bool			gun_mode		= false;			// Gun/iron mode
+		uint8_t			page			= 0;				// Current debug page
+		const uint8_t	page_prof		= 1;				// ISR profile page
+		const uint8_t	page_hist		= 2;				// First ISR histogram page
+		const uint8_t	page_boot		= page_hist + PROF_NUM;	// Boot time page
+		const uint8_t	page_adc		= page_boot + 1;	// ADC statistics page
+		const uint8_t	page_power		= page_adc + 1;		// Power budget statistics page
+		const uint8_t	pages			= page_power + 1;
 		const uint16_t	max_iron_power 	= 300;
 		const uint16_t	min_fan_speed	= 600;
 		const uint16_t	max_fan_power 	= 1999;
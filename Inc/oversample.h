@@ -0,0 +1,80 @@
+/*
+ * oversample.h
+ *
+ *  ADC window oversampling and decimation
+ *  The ADC window is written by DMA in dual mode: adc1-rank1, adc2-rank1, adc1-rank2, adc2-rank2, ...
+ *  The slot is the position of the sample inside one loop of the window, the slot mask selects the channel samples
+ *  The decimation ratio is the number of windows summed by the decimator (see OVERSAMPLER::DECIMATOR)
+ */
+
+#ifndef OVERSAMPLE_H_
+#define OVERSAMPLE_H_
+
+#include "main.h"
+
+// The slot mask of the ADC1 rank (0-based) or ADC2 rank in the window loop
+#define ADC1_SLOT(rank)		(1UL << (2*(rank)))
+#define ADC2_SLOT(rank)		(1UL << (2*(rank)+1))
+
+constexpr uint8_t adcLog2(uint32_t n) {
+	return (n > 1)?(1 + adcLog2(n >> 1)):0;
+}
+
+template <uint8_t conv, uint8_t loops, uint8_t decim = 1>
+class OVERSAMPLER {
+	static_assert(decim > 0 && (decim & (decim - 1)) == 0, "The decimation ratio should be a power of 2");
+	public:
+		static constexpr uint8_t	stride	= 2*conv;			// Number of slots in one loop of the window
+		static constexpr uint16_t	size	= stride*loops;		// Number of samples in the window
+		static constexpr uint8_t	ratio	= decim;			// Number of windows per decimated value
+		static constexpr uint8_t	extra_bits	= adcLog2(decim) / 2;	// The noise of 'decim' windows is averaged: half a bit per doubling
+		// Summary of all the samples selected by slot mask in the window
+		template <uint32_t mask>
+		static uint32_t	sum(volatile uint16_t* data) {
+			static_assert(mask != 0 && (mask >> stride) == 0, "Wrong ADC slot mask");
+			uint32_t summ = 0;
+			for (uint16_t i = 0; i < size; i += stride) {
+				for (uint8_t s = 0; s < stride; ++s) {			// Unrolled by compiler, mask is constant
+					if (mask & (1UL << s))
+						summ += data[i+s];
+				}
+			}
+			return summ;
+		}
+		// Rounded average of the samples selected by slot mask
+		template <uint32_t mask>
+		static uint32_t	average(volatile uint16_t* data) {
+			constexpr uint16_t n = samples(mask) * loops;
+			return (sum<mask>(data) + n/2) / n;
+		}
+		static constexpr uint16_t samples(uint32_t mask) {
+			return (mask)?((mask & 1) + samples(mask >> 1)):0;
+		}
+
+		/*
+		 * Decimating boxcar (first order CIC) of the channel selected by slot mask. The sums of 'decim' successive
+		 * windows are accumulated, one value is produced per 'decim' windows, so the cost per sample is the same
+		 * addition as the window average. The value is the average in ADC units with extra_bits of the fraction
+		 */
+		template <uint32_t mask>
+		class DECIMATOR {
+			public:
+				void		reset(void)						{ summ = 0; cnt = 0; }
+				bool		update(volatile uint16_t* data) {	// Add the window, true if new value is ready
+					summ += OVERSAMPLER::template sum<mask>(data);
+					if (++cnt < decim) return false;
+					constexpr uint32_t n = samples(mask) * loops * decim;
+					value	= ((summ << extra_bits) + n/2) / n;
+					summ	= 0;
+					cnt		= 0;
+					return true;
+				}
+				uint32_t	read(void)						{ return value; }
+			private:
+				uint32_t	summ	= 0;
+				uint32_t	value	= 0;
+				uint8_t		cnt		= 0;
+		};
+};
+
+#endif
@@ -12,6 +12,27 @@
 #include "stat.h"
 #include "vars.h"
 
+/*
+ * First order plus dead time (FOPDT) model of the heater, identified by the asymmetric relay, see PIDTUNE::identify()
+ */
+typedef struct s_fopdt FOPDT;
+struct s_fopdt {
+	uint16_t	K;										// The static gain, internal temperature units per power unit * 16
+	uint32_t	T;										// The time constant, ms
+	uint32_t	L;										// The dead time, ms
+};
+
+/*
+ * The PID algorithm history to resume the control without the restart, see IRON::hotSwap()
+ */
+typedef struct s_pid_state PID_STATE;
+struct s_pid_state {
+	int32_t		power;									// The iterative power multiplied by denominator and 2**rate_shift
+	int32_t		ff_applied;								// The feedforward power included into the iterative power
+	uint8_t		rate_shift;
+	bool		valid;									// The PID has been run since reset
+};
+
 class PIDparam {
 	public:
 		PIDparam(int32_t Kp = 0, int32_t Ki = 0, int32_t Kd = 0);
@@ -30,34 +51,109 @@ class PIDparam {
  *  U0 = Kp*(Xs - X0) + Ki*(Xs - X0); Xn-1 = Xn;
  *  
  *  The default values of PID coefficients can be found in config.cpp
+ *  The coefficients are kept for the nominal 50 Hz control period. If the control loop runs 2**rate_shift times faster,
+ *  Ki is divided and Kd is multiplied by 2**rate_shift in reqPower(), so the saved coefficients are valid in both modes
+ *
+ *  The PID class keeps the coefficients and the algorithm history, the PID_ENGINE template implements the algorithm
+ *  for the given denominator and output range
+ *
+ *  The feedforward power (the power required to keep the preset temperature) is added to the iterative power
+ *  when it changes, so the integral term corrects the model error only
  */
 class PID {
 	public:
-		PID(void) 											{ }
+		PID(uint8_t denominator_p = 11) : denominator_p(denominator_p)	{ }
 		void		load(const PIDparam &p);
 		PIDparam	dump(void)								{ return PIDparam(Kp, Ki, Kd);	}
-		void		init(uint8_t denominator_p = 11);
+		void		init(void);
 		void 		resetPID(void);        					// reset PID algorithm history parameters
-		int32_t 	reqPower(int16_t temp_set, int16_t temp_curr);
 		int32_t  	changePID(uint8_t p, int32_t k);    	// set or get (if parameter < 0) PID parameter
-		void		newPIDparams(uint16_t delta_power, uint32_t diff, uint32_t period);
-	private:
-		void  		debugPID(int t_set, int t_curr, long kp, long ki, long kd, long delta_p);
+		void		newPIDparams(uint16_t delta_power, uint32_t diff, uint32_t period, uint32_t T = 50);
+		bool		modelPIDparams(const FOPDT &model, uint32_t T = 50);	// AMIGO tuning rule for the FOPDT model
+		void		setRate(uint8_t shift);					// The control loop runs 2**shift times faster than nominal
+		void		feedForward(int32_t p)					{ ff_power = p; }	// The power estimated by the model
+		void		saveState(PID_STATE &s);				// Save the algorithm history
+		void		restoreState(const PID_STATE &s, int16_t temp);	// Resume the algorithm from the temperature
+	protected:
 		int16_t   	temp_h0			= 0;					// previously measured temperatures
 		int16_t	  	temp_h1			= 0;
 		int32_t  	i_summ			= 0;					// Ki summary multiplied by denominator
 		int32_t  	power			= 0;					// The power iterative multiplied by denominator
+		int32_t		ff_power		= 0;					// The feedforward power
+		int32_t		ff_applied		= 0;					// The feedforward power included into the iterative power
 		int32_t  	Kp 				= 10;					// The PID coefficients multiplied by denominator.
 		int32_t     Ki 				= 10;
 		int32_t		Kd				= 0;
-		int16_t  	denominator_p	= 11;              		// The common coefficient denominator power of 2 (11 means 2048)
+		const uint8_t	denominator_p;              		// The common coefficient denominator power of 2 (11 means 2048)
+		uint8_t		rate_shift		= 0;					// The control loop rate is 2**rate_shift of nominal one
+		static const uint8_t	max_rate_shift	= 1;		// Maximum supported control loop rate shift
 };
 
+/*
+ * The PID algorithm with the compile-time denominator (power of 2) and the output range.
+ * The iterative power is clamped to the output range, so the integral term does not wind up
+ * while the output is saturated: the required power leaves the limit as soon as the temperature error changes its sign.
+ * The increment is calculated in 64 bits and the accumulator is saturated, so big coefficients cannot overflow it
+ */
+template <uint8_t denominator, int32_t out_min, int32_t out_max>
+class PID_ENGINE : public PID {
+	public:
+		PID_ENGINE(void) : PID(denominator)					{ }
+		int32_t		reqPower(int16_t temp_set, int16_t temp_curr);
+	private:
+		static_assert(out_min < out_max, "Wrong PID output range");
+		static_assert(((int64_t)out_max << (denominator + max_rate_shift + 1)) < INT32_MAX, "PID accumulator can overflow");
+		static_assert(((int64_t)out_min << (denominator + max_rate_shift + 1)) > INT32_MIN, "PID accumulator can overflow");
+		int32_t		saturate(int64_t value);
+};
+
+// Clamp the value to the output range multiplied by current denominator
+template <uint8_t denominator, int32_t out_min, int32_t out_max>
+int32_t PID_ENGINE<denominator, out_min, out_max>::saturate(int64_t value) {
+	uint8_t d_p	= denominator + rate_shift;
+	int32_t lo	= out_min * (1L << d_p);
+	int32_t hi	= out_max * (1L << d_p);
+	if (value < lo) return lo;
+	if (value > hi) return hi;
+	return (int32_t)value;
+}
+
+template <uint8_t denominator, int32_t out_min, int32_t out_max>
+int32_t PID_ENGINE<denominator, out_min, out_max>::reqPower(int16_t temp_set, int16_t temp_curr) {
+	int64_t rate = 1 << rate_shift;
+	uint8_t	 d_p = denominator + rate_shift;
+	if (temp_h0 == 0) {										// Use direct formulae because do not know previous temperature
+		i_summ	= temp_set - temp_curr;
+		power	= saturate((int64_t)Kp * (temp_set - temp_curr) * rate + (int64_t)Ki * i_summ + ((int64_t)ff_power << d_p));
+	} else {
+		int64_t kp = (int64_t)Kp * (temp_h1 - temp_curr) * rate;
+		int64_t ki = (int64_t)Ki * (temp_set - temp_curr);
+		int64_t kd = (int64_t)Kd * (temp_h0 + temp_curr - 2 * temp_h1) * rate * rate;
+		int64_t kf = (int64_t)(ff_power - ff_applied) << d_p;
+		power = saturate(power + kp + ki + kd + kf);		// Power is stored multiplied by denominator and 2**rate_shift!
+	}
+	ff_applied	= ff_power;
+	temp_h0 = temp_h1;
+	temp_h1 = temp_curr;
+	int32_t pwr = power + (1 << (d_p-1));					// prepare the power to divide by denominator, round the result
+	pwr >>= d_p;											// divide by the denominator
+	return pwr;
+}
+
+/*
+ * The relay method: the power switches between base_power + delta_power and base_power - delta_low
+ * when the temperature crosses base_temp -+ delta_temp. If delta_low differs from delta_power (asymmetric relay),
+ * the average power of the cycle differs from the base power and the static gain of the heater can be measured as
+ * the ratio of the temperature and power deviation integrals. The integrals are accumulated over all whole cycles:
+ * one cycle is too short, the power switches once per control period. See identify()
+ */
 class PIDTUNE {
 	public:
-		PIDTUNE(void) : period(auto_pid_hist_length), temp_max(auto_pid_hist_length), temp_min(auto_pid_hist_length)		{ 	}
-		void		start(uint16_t base_pwr, uint16_t delta_power, uint16_t base_temp, uint16_t delta_temp);
+		PIDTUNE(void) : period(auto_pid_hist_length), temp_max(auto_pid_hist_length), temp_min(auto_pid_hist_length),
+						on_time(auto_pid_hist_length)				{ 	}
+		void		start(uint16_t base_pwr, uint16_t delta_power, uint16_t base_temp, uint16_t delta_temp, uint16_t delta_low = 0);
 		uint16_t	run(uint32_t t);
+		bool		identify(FOPDT &model);					// Identify the FOPDT model by measured relay oscillations
 		uint16_t	autoTuneLoops(void)						{ return loops; 						}
 		uint32_t	autoTunePeriod(void)					{ return period.read();					}
 		uint16_t	tempMin(void)							{ return temp_min.read();   			}
@@ -66,8 +162,19 @@ class PIDTUNE {
 		HIST		period;									// Average value of relay method oscillations period
 		HIST		temp_max;								// Average value of maximum temperature
 		HIST		temp_min;								// Average value of minimum temperature
+		HIST		on_time;								// Average time of applying extra power in the cycle, ms
 		volatile	uint16_t	base_power		= 0;		// Base power value
 		volatile 	uint16_t 	delta_power		= 0;		// PLUS delta power applied
+		volatile 	uint16_t 	delta_low		= 0;		// MINUS delta power applied
+		volatile	uint32_t	on_start		= 0;		// The time (ms) when the extra power was applied
+		volatile	uint32_t	last_run		= 0;		// The time (ms) of the previous run() call
+		volatile	int32_t		sum_temp		= 0;		// The integral of the temperature deviation in the cycle, units * ms
+		volatile	int32_t		sum_power		= 0;		// The integral of the power deviation in the cycle, power * ms
+		volatile	int32_t		all_temp		= 0;		// The temperature deviation integral of all whole cycles
+		volatile	int32_t		all_power		= 0;		// The power deviation integral of all whole cycles
+		volatile	int16_t		first_dev		= 0;		// The temperature deviation at the start of the first whole cycle
+		volatile	int16_t		last_dev		= 0;		// The temperature deviation at the end of the last whole cycle
+		volatile	int16_t		power_dev		= 0;		// The power deviation applied since the previous run() call
 		volatile	uint16_t	base_temp		= 0;		// Base temperature value
 		volatile	uint16_t	delta_temp		= 0;		// The temperature limit (base_temp - delta_temp <= t <= base_temp + delta_temp)
 		volatile	bool		app_delta_power	= false;	// Do apply delta power
@@ -0,0 +1,45 @@
+/*
+ * prof.h
+ *
+ *  Interrupt service routines execution time profiler
+ *  On the controller the time is measured by DWT cycle counter.
+ *  The host build (no HAL) uses std::chrono, the time unit is 1 ns
+ */
+
+#ifndef PROF_H_
+#define PROF_H_
+
+#ifdef USE_HAL_DRIVER
+#include "main.h"
+#else
+#include <stdint.h>
+#endif
+
+#define PROF_HIST_SZ	(16)								// log2 histogram size: up to 2**15 cycles
+
+typedef enum { PROF_TIM = 0, PROF_ADC, PROF_ENCODER, PROF_CONTROL, PROF_NUM } t_prof_isr;
+
+class ISR_PROF {
+	public:
+		ISR_PROF(void)										{ reset(); }
+		static void		init(void);							// Start the cycle counter
+		static uint32_t	cycles(void);						// Current value of the cycle counter
+		static uint32_t	toUs(uint32_t cycles);				// Convert cycles to microseconds
+		void			reset(void);
+		void			update(uint32_t start);				// Save the time elapsed since the start cycle
+		uint32_t		minTime(void)						{ return (n)?t_min:0; 	}
+		uint32_t		maxTime(void)						{ return t_max; 		}
+		uint32_t		meanTime(void)						{ return (n)?(t_summ + n/2)/n:0; }
+		uint16_t		hist(uint8_t index)					{ return (index < PROF_HIST_SZ)?histogram[index]:0; }
+		uint16_t		histMax(void);						// Maximum value of the histogram
+	private:
+		volatile uint32_t	t_min, t_max;					// Minimum and maximum execution time
+		volatile uint32_t	t_summ;							// Summary execution time of the last n calls, halved with n before overflow
+		volatile uint32_t	n;								// Number of the calls
+		volatile uint16_t	histogram[PROF_HIST_SZ];		// The number of calls lasted [2**i, 2**(i+1)) cycles, halved on saturation
+		const uint32_t		max_n	= 65536;				// When number of calls reaches this value, the statistics is halved
+};
+
+extern ISR_PROF isr_prof[PROF_NUM];
+
+#endif
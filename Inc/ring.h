@@ -0,0 +1,43 @@
+/*
+ * ring.h
+ *
+ *  Lock-free single producer, single consumer ring buffer.
+ *  The producer (interrupt) changes the head only, the consumer changes the tail only.
+ *  The size should be a power of 2, one element is always kept free.
+ */
+
+#ifndef RING_H_
+#define RING_H_
+
+#include "main.h"
+
+template <typename T, uint8_t size>
+class RING {
+	public:
+		RING(void)											{ head = tail = 0; }
+		bool		isEmpty(void)							{ return head == tail; }
+		bool		push(const T& item) {
+			uint8_t nxt = (head + 1) & mask;
+			if (nxt == tail) return false;					// The ring is full, the item is lost
+			data[head]	= item;
+			__DMB();										// The item should be written before the head is moved
+			head		= nxt;
+			return true;
+		}
+		bool		pop(T& item) {
+			if (head == tail) return false;
+			__DMB();
+			item		= data[tail];
+			__DMB();										// The item should be read before the tail is moved
+			tail		= (tail + 1) & mask;
+			return true;
+		}
+	private:
+		static_assert(size >= 2 && (size & (size - 1)) == 0, "Ring size should be a power of 2");
+		static const uint8_t	mask = size - 1;
+		T						data[size];
+		volatile uint8_t		head;
+		volatile uint8_t		tail;
+};
+
+#endif
@@ -13,14 +13,110 @@
 class EMP_AVERAGE {
 	public:
 		EMP_AVERAGE(uint8_t h_length = 8)				{ emp_k = h_length; emp_data = 0; }
-		void			length(uint8_t h_length)		{ emp_k = h_length; emp_data = 0; }
-		void			reset(void)						{ emp_data = 0; }
+		void			length(uint8_t h_length)		{ emp_k = h_length; emp_data = 0; n_upd = 0; }
+		void			reset(void)						{ emp_data = 0; n_upd = 0; }
+		void			init(int32_t value)				{ emp_data = value * emp_k; n_upd = 1; }	// Start averaging from the value
+		void			rescale(uint8_t h_length)		{ emp_data = read() * h_length; emp_k = h_length; }	// Change length keeping the average
+		uint8_t			updates(void)					{ return n_upd; }
 		int32_t			average(int32_t value);
 		void			update(int32_t value);
 		int32_t			read(void);
 	private:
 		volatile	uint8_t 	emp_k 		= 8;
 		volatile	uint32_t	emp_data	= 0;
+		volatile	uint8_t		n_upd		= 0;			// Number of updates since reset, up to 255
+};
+
+/*
+ * Alpha-beta filter of the temperature: the steady state Kalman filter of the temperature and its rate.
+ * The applied power is the control input: the power change changes the heating rate by b*(power change),
+ * b is learned after the big power step: the rate corrections summed over the learning window are the rate change
+ * the power input did not predict. The heater dead time delays the response, so b cannot be learned from
+ * the correction at the step itself. The step is skipped if the power changes much in the window.
+ * Unlike the cascade of exponential averages, the filter does not lag behind the temperature that changes
+ * with constant rate.
+ * The temperature and the rate (per control period) are kept multiplied by 256, the gains are multiplied by 4096,
+ * b is multiplied by 65536. When the control period becomes 2**shift times shorter, the gains are decreased
+ * to keep the filter bandwidth, see rescale()
+ */
+class ALPHA_BETA {
+	public:
+		ALPHA_BETA(void)								{ }
+		void			reset(void)						{ n_upd = 0; learn_cnt = 0; }
+		void			update(int32_t value, int32_t power);
+		void			rescale(uint8_t shift);
+		int32_t			read(void)						{ return (x + 128) >> 8; }
+		int32_t			rate(void)						{ return v << shift; }	// Per nominal control period * 256
+		int32_t			gain(void)						{ return b << shift; }	// The rate per power unit per nominal control period * 65536
+		uint8_t			gainUpdates(void)				{ return n_learn; }		// The number of the learned gain updates, up to 255
+		uint8_t			updates(void)					{ return n_upd; }
+	private:
+		volatile	int32_t		x			= 0;			// The temperature estimation * 256
+		volatile	int32_t		v			= 0;			// The temperature rate estimation (per period) * 256
+		volatile	int32_t		b			= 0;			// The power to rate coefficient * 65536
+		volatile	int32_t		last_power	= 0;
+		volatile	uint8_t		n_upd		= 0;			// Number of updates since reset, up to 255
+		volatile	uint8_t		n_learn		= 0;			// Number of the power to rate coefficient updates, up to 255
+		volatile	int32_t		learn_dp	= 0;			// The power step to learn b
+		volatile	int32_t		learn_ev	= 0;			// The sum of the rate corrections after the step
+		volatile	int32_t		learn_var	= 0;			// The sum of the absolute power changes after the step
+		volatile	uint16_t	learn_cnt	= 0;			// The periods left in the learning window, 0 - not learning
+		uint8_t		shift			= 0;					// The control period is 2**shift times shorter than nominal
+		uint16_t	alpha			= 384;					// 0.094 * 4096
+		uint16_t	beta			= 19;					// alpha**2 / (2 - alpha) * 4096
+		const uint16_t	alpha_nom	= 384;
+		const uint16_t	beta_nom	= 19;
+		const uint8_t	lms_shift	= 1;					// The learning rate of b
+		const uint8_t	learn_window= 32;					// The learning window, nominal control periods
+		const int32_t	min_learn_dp= 100;					// The minimum power step to learn b
+		const int32_t	max_b		= 1024;
+		const int32_t	max_error	= 1000 << 8;			// Limit the innovation of the corrupted measurement
+};
+
+/*
+ * Thermal model check of the heater. The model: the temperature rate is proportional to the applied power,
+ * the gain (rate per power unit) is learned while heating up. The observed rate is compared with the rate expected
+ * for the applied power (both are averaged by the same exponential filter to match the heater delay):
+ * TG_RUNAWAY	- the temperature rises much faster than the power explains: shorted heater switch, the heater stuck at full power
+ * TG_NO_HEAT	- the heater is at full power far below the preset temperature but the temperature does not rise:
+ * 				  broken heater, the sensor has no thermal contact
+ * TG_SENSOR	- the temperature jumps and stays there, that is physically impossible, or the reading is saturated:
+ * 				  open or shorted thermocouple. The fault should persist longer than the tip removal is detected
+ * The rates are per control period * 256, the gain is the rate per power unit * 256. Before the gain is learned,
+ * the runaway is the temperature rising faster than min_rate without power and the no heating check is disabled
+ */
+class THERMAL_GUARD {
+	public:
+		typedef enum { TG_OK = 0, TG_RUNAWAY, TG_NO_HEAT, TG_SENSOR } t_fault;
+		THERMAL_GUARD(uint16_t max_power, uint8_t rate_shift, uint16_t min_rate, uint16_t runaway_cycles,
+				uint16_t no_heat_cycles, uint16_t max_jump, uint8_t sensor_cycles) : max_power(max_power), rate_shift(rate_shift),
+				min_rate(min_rate), runaway_cycles(runaway_cycles), no_heat_cycles(no_heat_cycles), max_jump(max_jump),
+				sensor_cycles(sensor_cycles)	{ }
+		void		reset(void);							// Restart the rate calculation, keep the learned gain
+		t_fault		check(int32_t t, int32_t t_raw, int32_t power, bool heating);
+		t_fault		fault(void)								{ return fault_type; }
+		void		clear(void)								{ fault_type = TG_OK; reset(); }
+	private:
+		volatile	t_fault		fault_type	= TG_OK;
+		int32_t		prev_t			= -1;					// The temperature in previous period, -1 if unknown
+		int32_t		prev_raw		= -1;					// The last trusted raw temperature
+		int32_t		rate			= 0;					// Averaged observed temperature rate * 256
+		int32_t		pwr				= 0;					// Averaged power * 256
+		int32_t		gain			= 0;					// Learned rate per power unit * 256
+		uint8_t		gain_upd		= 0;					// Number of the gain updates
+		uint16_t	run_cnt			= 0;					// Successive periods of the fault conditions
+		uint16_t	no_heat_cnt		= 0;
+		uint8_t		jump_cnt		= 0;
+		const uint16_t	max_power;
+		const uint8_t	rate_shift;							// The exponential filter coefficient is 2**rate_shift
+		const uint16_t	min_rate;							// Minimal runaway rate * 256
+		const uint16_t	runaway_cycles;
+		const uint16_t	no_heat_cycles;
+		const uint16_t	max_jump;							// Maximum temperature change in one period
+		const uint8_t	sensor_cycles;						// Successive periods of the jumped or saturated reading
+		const uint16_t	raw_saturated	= 4080;				// The ADC reading of the open thermocouple
+		const uint8_t	gain_learned	= 64;				// The gain updates to use it
+		const uint8_t	gain_shift		= 4;				// The gain exponential filter coefficient is 2**gain_shift
 };
 
 #define H_LENGTH (16)
@@ -44,13 +140,17 @@ class HIST {
 class SWITCH : public EMP_AVERAGE {
     public:
         SWITCH(uint8_t len=8) : EMP_AVERAGE(len)			{ }
-        void        init(uint8_t h_len, uint16_t on = 500, uint16_t off = 500);
+        void        init(uint8_t h_len, uint16_t on = 500, uint16_t off = 500, uint8_t fast = 0, bool first = false);
         bool        status(void)							{ return mode; }
+        bool		settled(void)							{ return updates() > 0; }
         bool		changed(void);
         void		update(uint16_t value);
     private:
         bool		sw_changed	= false;					// The status has changed flag
         bool        mode	= false;               			// The switch mode on (true)/off
+        uint8_t		fast_len	= 0;						// Successive values beyond the threshold to change the status at once, 0 - disabled
+        uint8_t		fast_cnt	= 0;
+        bool		first_read	= false;					// Take the status from the first value after init (boot), do not average
         int16_t    	on_val  = 400;                 			// Turn on  value
         int16_t    	off_val = 500;                 			// Turn off value
 };
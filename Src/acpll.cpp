@@ -0,0 +1,87 @@
+/*
+ * acpll.cpp
+ *
+ */
+
+#include <stdlib.h>
+#include "acpll.h"
+#include "prof.h"
+#include "tools.h"
+
+void AC_PLL::init(void) {
+	half_period	= 0;
+	i_summ		= 0;
+	good_edges	= 0;
+	locked		= false;
+	synced		= false;
+	last_cycle	= ISR_PROF::cycles();
+	last_ms		= HAL_GetTick() - ac_timeout;				// No AC power detected yet
+}
+
+bool AC_PLL::acPresent(void) {
+	return (HAL_GetTick() - last_ms) < ac_timeout;
+}
+
+uint16_t AC_PLL::frequency(void) {
+	if (!acPresent() || half_period == 0) return 0;
+	return (SystemCoreClock * 5 * hp_emp_k + half_period/2) / half_period;	// 10 * Clock / (2 * half_period)
+}
+
+void AC_PLL::zeroCross(void) {
+	uint32_t now			= ISR_PROF::cycles();
+	uint32_t interval		= now - last_cycle;
+	uint32_t cycles_per_ms	= SystemCoreClock / 1000;
+	if (interval < min_hp_ms * cycles_per_ms) return;		// The noise on AC_ZERO pin, ignore
+	last_cycle	= now;
+	last_ms		= HAL_GetTick();
+	if (interval > max_hp_ms * cycles_per_ms) {				// The pulse missed or the AC power has just appeared, restart
+		good_edges	= 0;
+		locked		= false;
+		return;
+	}
+	if (half_period == 0) {
+		half_period	= interval * hp_emp_k;
+	} else {
+		half_period	+= interval - (half_period + hp_emp_k/2) / hp_emp_k;
+	}
+
+	// Synchronize TIM2 if its period is a multiple of the AC half period
+	uint32_t hp_ticks	= half_period / hp_emp_k / (TIM2->PSC + 1);
+	if (hp_ticks == 0) return;
+	uint8_t	 k			= (tim2_period + hp_ticks/2) / hp_ticks;	// Number of AC half periods in the TIM2 period
+	if (k == 0 || abs((int32_t)(k * hp_ticks) - tim2_period) > max_adjust * k) {
+		locked		= false;								// Cannot synchronize, TIM2 is running free
+		TIM2->ARR	= tim2_period - 1;
+		return;
+	}
+	uint16_t step	= tim2_period / k;						// TIM2 counter value at the zero crossing should be multiple of step
+	uint16_t cnt	= TIM2->CNT;
+	int16_t  e		= cnt % step;							// The phase error, TIM2 ticks
+	if (e > step/2) e -= step;
+
+	/*
+	 * Move TIM2 counter to the zero crossing point at startup only. Later the counter jump could skip or repeat
+	 * the compare events of the working TIM2 (IRON pulse, current sample, temperature window), so the lost lock
+	 * is restored by the period correction below
+	 */
+	if (!synced && abs(e) > snap_error) {
+		int32_t n_cnt = (int32_t)cnt - e;
+		if (n_cnt >= tim2_period) n_cnt -= tim2_period;
+		TIM2->CNT	= n_cnt;
+		i_summ		= 0;
+		good_edges	= 0;
+		return;
+	}
+
+	if (abs(e) <= lock_error) {
+		if (good_edges < lock_edges) ++good_edges;
+		else locked = synced = true;
+	} else if (abs(e) > snap_error) {
+		locked		= false;
+		good_edges	= 0;
+	}
+	i_summ	= constrain(i_summ + e, -16*max_adjust, 16*max_adjust);
+	int16_t adj		= constrain(e/2 + i_summ/16, -max_adjust, max_adjust);
+	if (cnt < tim2_period - 4*max_adjust)					// Do not let ARR become less than the counter
+		TIM2->ARR	= tim2_period - 1 + adj;
+}
@@ -0,0 +1,96 @@
+/*
+ * budget.cpp
+ *
+ */
+
+#include "budget.h"
+#include "tools.h"
+
+void PWR_BUDGET::init(uint16_t watts) {
+	budget		= watts;
+	iron_debt	= 0;
+	iron_sum	= 0;
+	iron_cnt	= 0;
+	iron_max	= 0;
+}
+
+/*
+ * Called once per TIM1 period (100 mains half-waves). The IRON requests of the previous period show the IRON power share
+ * to be reserved: the average budget and, when the heaters are interleaved, the time when the Hot Air Gun is off.
+ * The IRON is powered by whole TIM2 periods not longer than max_pwm, so the Hot Air Gun leaves enough TIM2 periods off
+ * for the IRON share, and the last TIM2 period of TIM1 period is lost: the triac is on at the next TIM1 period start
+ */
+uint16_t PWR_BUDGET::gun(uint16_t request) {
+	uint16_t periods	= iron_cnt;							// Number of TIM2 periods in TIM1 period
+	uint32_t i_avg		= 0;								// The average IRON request (TIM2 ticks)
+	if (periods > 0)
+		i_avg = (iron_sum + periods/2) / periods;
+	iron_sum	= 0;
+	iron_cnt	= 0;
+	if (budget == 0 || request == 0) return request;
+
+	if (gun_first)											// The IRON keeps its minimal share only
+		i_avg = (i_avg * min_share + 99) / 100;
+	uint32_t i_pcnt	= (i_avg * 100 + iron_ticks - 1) / iron_ticks;
+	int32_t g_max	= ((int32_t)budget - (int32_t)(iron_watts * i_pcnt / 100)) * gun_half_waves / gun_watts;
+	if (budget < gun_watts + iron_watts && periods > 0 && iron_max > 0) {	// The IRON is powered when the Hot Air Gun is off
+		int32_t off	= (i_avg * periods + iron_max - 1) / iron_max;		// TIM2 periods at max_pwm
+		int32_t i_max	= gun_half_waves - off * (gun_half_waves / periods) - 2;
+		if (g_max > i_max) g_max = i_max;
+	}
+	if (g_max < 0) g_max = 0;
+	uint16_t grant = constrain(request, 0, g_max);
+	if (!gun_first) {										// Do not starve the Hot Air Gun
+		uint16_t g_min = (request * min_share + 50) / 100;
+		if (grant < g_min) grant = g_min;
+	}
+	gun_cut += request - grant;
+	return grant;
+}
+
+/*
+ * Called by the control task every TIM2 period. gun_on is true if the Hot Air Gun triac would be on in the next period.
+ * The IRON power should not exceed max_pwm
+ */
+uint16_t PWR_BUDGET::iron(uint16_t request, uint16_t max_pwm, bool gun_on) {
+	iron_sum += request;
+	++iron_cnt;
+	iron_max = max_pwm;
+	uint16_t grant = request;
+	if (request == 0) {										// The IRON does not require power, forget postponed power
+		iron_debt = 0;
+	} else if (budget > 0 && budget < gun_watts + iron_watts) {
+		if (gun_on) {										// Postpone the IRON power
+			iron_debt += request;
+			if (iron_debt > max_debt) iron_debt = max_debt;
+			grant = 0;
+			++iron_cut;
+		} else if (iron_debt && max_pwm > request) {		// Apply postponed power
+			uint16_t extra = max_pwm - request;
+			if (extra > iron_debt) extra = iron_debt;
+			grant		+= extra;
+			iron_debt	-= extra;
+		}
+	} else {
+		iron_debt = 0;
+	}
+	uint16_t watts = (gun_on?gun_watts:0) + (grant?iron_watts:0);
+	if (watts > peak_watts) peak_watts = watts;
+	return grant;
+}
+
+uint32_t PWR_BUDGET::statistics(t_pwr_stat stat) {
+	switch (stat) {
+		case PWR_PEAK_W:
+			return peak_watts;
+		case PWR_PEAK_A:									// Tenths of ampere
+			return (peak_watts * 10 + mains_volts/2) / mains_volts;
+		case PWR_IRON_CUT:
+			return iron_cut;
+		case PWR_GUN_CUT:
+			return gun_cut;
+		default:
+			break;
+	}
+	return 0;
+}
@@ -31,6 +31,7 @@ CFG_STATUS CFG::init(void) {
 	uint8_t tips_loaded = 0;
 
 	if (EEPROM::init()) {
+		migrateTipArea();									// Convert the tip area saved by the old firmware
 		if (tip_table) {
 			tips_loaded = buildTipTable(tip_table);
 		}
@@ -40,17 +41,27 @@ CFG_STATUS CFG::init(void) {
 		} else {
 			setDefaults();
 		}
+		if (!loadSchedule(&pid_sched)) {
+			pid_sched.mask			= 0;					// No bands set up, use PID parameters from the configuration record
+			pid_sched.power_budget	= 0;
+			pid_sched.tip_layout	= 0;					// Check the tip area on the next start
+			pid_sched.reserved		= 0;
+		}
+		if (!loadGunModel(&gun_model))
+			memset(&gun_model, 0, sizeof(GUN_MODEL));		// The model was not identified, the fan reference was not learned yet
 
 		selectTip(0);										// Load Hot Air Gun calibtarion data (virtual tip)
 		selectTip(a_cfg.tip);								// Load tip configuration data into a_tip variable
 		CFG_CORE::syncConfig();								// Save spare configuration
 		if (tips_loaded > 0) {
-			return CFG_OK;
+			return isOldTipArea()?CFG_OLD_TIPS:CFG_OK;
 		} else {
 			return CFG_NO_TIP;
 		}
 	} else {
 		setDefaults();
+		pid_sched.mask = 0;
+		memset(&gun_model, 0, sizeof(GUN_MODEL));
 		TIP_CFG::defaultCalibration(0);						// 0 means Hot Air Gun
 		selectTip(1);
 		CFG_CORE::syncConfig();
@@ -62,14 +73,19 @@ CFG_STATUS CFG::init(void) {
 bool CFG::selectTip(uint8_t index) {
 	if (!tip_table) return false;
 	bool result = true;
+	TIP tip;
+	tip.Kp = tip.Ki = tip.Kd = 0;							// Use the global PID coefficients if the tip record is not loaded
+	tip.boost_lag = 0;
 	uint8_t tip_chunk_index = tip_table[index].tip_chunk_index;
 	if (tip_chunk_index == NO_TIP_CHUNK) {
 		TIP_CFG::defaultCalibration(index == 0);			// index == 0 means Hot Air Gun
+		TIP_CFG::applyTipPID(tip, index == 0);
 		return false;
 	}
-	TIP tip;
 	if (loadTipData(&tip, tip_chunk_index) != EPR_OK) {
 		TIP_CFG::defaultCalibration(index == 0);			// index == 0 means Hot Air Gun
+		tip.Kp = tip.Ki = tip.Kd = 0;
+		tip.boost_lag = 0;
 		result = false;
 	} else {
 		if (!(tip.mask & TIP_CALIBRATED)) {					// Tip is not calibrated, load default config
@@ -80,6 +96,7 @@ bool CFG::selectTip(uint8_t index) {
 			TIP_CFG::load(tip, index == 0);
 		}
 	}
+	TIP_CFG::applyTipPID(tip, index == 0);					// The tip PID and heat lag do not depend on calibration
 	return result;
 }
 
@@ -197,6 +214,92 @@ void CFG::savePID(PIDparam &pp, bool iron) {
 	CFG_CORE::syncConfig();
 }
 
+// The IRON PID coefficients of the current tip if set up or the configuration record coefficients
+PIDparam CFG::pidParams(bool iron) {
+	if (iron && !TIP_CFG::gunActive() && TIP_CFG::hasTipPID())
+		return TIP_CFG::tipPID();
+	return CFG_CORE::pidParams(iron);
+}
+
+// Save the IRON PID coefficients of the current tip. The global coefficients clear the tip PID
+bool CFG::saveTipPID(PIDparam &pp) {
+	if (!tip_table || TIP_CFG::gunActive() || isOldTipArea()) return false;	// The old tip record has no PID coefficients
+	uint8_t tip_chunk_index = tip_table[a_cfg.tip].tip_chunk_index;
+	if (tip_chunk_index == NO_TIP_CHUNK) return false;		// The tip is not saved in the EEPROM
+	TIP tip;
+	if (loadTipData(&tip, tip_chunk_index) != EPR_OK) return false;
+	PIDparam global = CFG_CORE::pidParams(true);
+	if (pp.Kp == global.Kp && pp.Ki == global.Ki && pp.Kd == global.Kd) {
+		tip.Kp = tip.Ki = tip.Kd = 0;
+	} else {
+		tip.Kp	= pp.Kp;
+		tip.Ki	= pp.Ki;
+		tip.Kd	= pp.Kd;
+	}
+	if (saveTipData(&tip, tip_chunk_index) != EPR_OK) return false;
+	TIP_CFG::applyTipPID(tip);
+	return true;
+}
+
+// The IRON PID coefficients of the temperature band or the configuration record coefficients if the band is not set up
+PIDparam CFG::pidBand(uint8_t band) {
+	if (band < PID_BANDS && (pid_sched.mask & (1 << band)))
+		return PIDparam(pid_sched.Kp[band], pid_sched.Ki[band], pid_sched.Kd[band]);
+	return pidParams(true);
+}
+
+// Interpolate the IRON PID coefficients between the band centers, the tip calibration points
+PIDparam CFG::pidScheduled(uint16_t temp) {
+	if (pid_sched.mask == 0 || TIP_CFG::gunActive() || TIP_CFG::hasTipPID()) // The tip PID overrides the schedule
+		return pidParams(true);
+	if (temp <= TIP_CFG::calibration(0))
+		return pidBand(0);
+	for (uint8_t i = 1; i < PID_BANDS; ++i) {
+		uint16_t t_high = TIP_CFG::calibration(i);
+		if (temp < t_high) {
+			uint16_t t_low	= TIP_CFG::calibration(i-1);
+			PIDparam low	= pidBand(i-1);
+			PIDparam high	= pidBand(i);
+			return PIDparam(map(temp, t_low, t_high, low.Kp, high.Kp),
+							map(temp, t_low, t_high, low.Ki, high.Ki),
+							map(temp, t_low, t_high, low.Kd, high.Kd));
+		}
+	}
+	return pidBand(PID_BANDS-1);
+}
+
+void CFG::savePIDband(uint8_t band, PIDparam &pp) {
+	if (band >= PID_BANDS) return;
+	pid_sched.Kp[band]	= pp.Kp;
+	pid_sched.Ki[band]	= pp.Ki;
+	pid_sched.Kd[band]	= pp.Kd;
+	pid_sched.mask		|= 1 << band;
+	saveSchedule(&pid_sched);
+}
+
+void CFG::savePowerBudget(uint16_t watts) {
+	pid_sched.power_budget = constrain(watts / 100, 0, 255);
+	saveSchedule(&pid_sched);
+}
+
+// Save the Hot Air Gun model identified by the PID autotune, the times are in TIM1 periods
+bool CFG::saveGunModel(uint16_t K, uint16_t T, uint8_t L) {
+	gun_model.K			= K;
+	gun_model.T			= T;
+	gun_model.L			= L;
+	gun_model.reserved	= 0;
+	return EEPROM::saveGunModel(&gun_model);
+}
+
+// Save the fan reference points learned by the Hot Air Gun fan regulator, see FAN_REG
+bool CFG::saveGunFan(const uint16_t pwm[FAN_REF_POINTS], const uint16_t cur[FAN_REF_POINTS]) {
+	for (uint8_t i = 0; i < FAN_REF_POINTS; ++i) {
+		gun_model.fan_pwm[i]	= pwm[i];
+		gun_model.fan_cur[i]	= cur[i];
+	}
+	return EEPROM::saveGunModel(&gun_model);
+}
+
 // Save new IRON tip calibration data to the EEPROM only. Do not change active configuration
 void CFG::saveTipCalibtarion(uint8_t index, uint16_t temp[4], uint8_t mask, int8_t ambient) {
 	TIP tip;
@@ -206,11 +309,20 @@ void CFG::saveTipCalibtarion(uint8_t index, uint16_t temp[4], uint8_t mask, int8
 	tip.t400		= temp[3];
 	tip.mask		= mask;
 	tip.ambient		= ambient;
+	tip.Kp = tip.Ki = tip.Kd = 0;
+	tip.boost_lag	= 0;
 	tip_table[index].tip_mask	= mask;
 	const char* name	= TIPS::name(index);
 	if (name && isValidTipConfig(&tip)) {
 		strncpy(tip.name, name, tip_name_sz);
 		uint8_t tip_chunk_index = tip_table[index].tip_chunk_index;
+		TIP old_tip;
+		if (tip_chunk_index != NO_TIP_CHUNK && loadTipData(&old_tip, tip_chunk_index) == EPR_OK) {
+			tip.Kp	= old_tip.Kp;							// Keep the tip PID coefficients
+			tip.Ki	= old_tip.Ki;
+			tip.Kd	= old_tip.Kd;
+			tip.boost_lag	= old_tip.boost_lag;			// The heat lag does not depend on calibration
+		}
 		if (tip_chunk_index == NO_TIP_CHUNK) {				// This tip data is not in the EEPROM, it was not active!
 			tip_chunk_index = freeTipChunkIndex();
 			if (tip_chunk_index == NO_TIP_CHUNK) {			// Failed to find free slot to save tip configuration
@@ -228,6 +340,34 @@ void CFG::saveTipCalibtarion(uint8_t index, uint16_t temp[4], uint8_t mask, int8
 
 }
 
+// Save the learned feedforward coefficient of the current calibrated tip to the EEPROM
+void CFG::saveTipFeedForward(uint8_t ff) {
+	if (!tip_table || TIP_CFG::gunActive() || !TIP_CFG::isTipCalibrated()) return;
+	uint8_t index			= a_cfg.tip;
+	uint8_t tip_chunk_index = tip_table[index].tip_chunk_index;
+	if (tip_chunk_index == NO_TIP_CHUNK) return;
+	TIP tip;
+	if (loadTipData(&tip, tip_chunk_index) != EPR_OK) return;
+	tip.mask &= ~TIP_FF_MASK;
+	tip.mask |= (ff << TIP_FF_SHIFT) & TIP_FF_MASK;
+	if (saveTipData(&tip, tip_chunk_index) == EPR_OK) {
+		tip_table[index].tip_mask	= tip.mask;
+		TIP_CFG::applyTipFeedForward(ff);
+	}
+}
+
+// Save the heat lag of the current tip identified by the boost to the EEPROM
+void CFG::saveTipBoostLag(uint8_t lag) {
+	if (!tip_table || TIP_CFG::gunActive() || isOldTipArea()) return;	// The old tip record has no heat lag
+	uint8_t tip_chunk_index = tip_table[a_cfg.tip].tip_chunk_index;
+	if (tip_chunk_index == NO_TIP_CHUNK) return;
+	TIP tip;
+	if (loadTipData(&tip, tip_chunk_index) != EPR_OK) return;
+	tip.boost_lag = lag;
+	if (saveTipData(&tip, tip_chunk_index) == EPR_OK)
+		TIP_CFG::applyTipBoostLag(lag);
+}
+
 // Toggle (activate/deactivate) tip activation flag. Do not change active tip configuration
 bool CFG::toggleTipActivation(uint8_t index) {
 	if (!tip_table)	return false;
@@ -240,6 +380,8 @@ bool CFG::toggleTipActivation(uint8_t index) {
 		if (name) {
 			strncpy(tip.name, name, tip_name_sz);			// Initialize tip name
 			tip.mask = TIP_ACTIVE;
+			tip.Kp = tip.Ki = tip.Kd = 0;					// Use the global PID coefficients
+			tip.boost_lag = 0;
 			if (saveTipData(&tip, tip_chunk_index) == EPR_OK) {
 				if (isTipCorrect(tip_chunk_index, &tip)) {
 					tip_table[index].tip_chunk_index	= tip_chunk_index;
@@ -315,7 +457,10 @@ int	CFG::tipList(uint8_t second, TIP_ITEM list[], uint8_t list_len, bool active_
 
 // Initialize the configuration area. Save default configuration to the EEPROM
 void CFG::initConfigArea(void) {
-	clearConfigArea();
+	clearConfigArea();										// Clears the PID gain schedule and the Hot Air Gun model also
+	pid_sched.mask			= 0;
+	pid_sched.power_budget	= 0;
+	memset(&gun_model, 0, sizeof(GUN_MODEL));
 	setDefaults();
 	saveRecord(&a_cfg);
 	clearAllTipsCalibration();
@@ -475,7 +620,7 @@ void CFG_CORE::correctConfig(RECORD *cfg) {
 }
 
 // Apply main configuration parameters: automatic off timeout, buzzer and temperature units
-void CFG_CORE::setup(uint8_t off_timeout, bool buzzer, bool celsius, bool keep_iron, bool reed, bool temp_step,
+void CFG_CORE::setup(uint8_t off_timeout, bool buzzer, bool celsius, bool keep_iron, bool reed, bool temp_step, bool fast_iron,
 		uint16_t low_temp, uint8_t low_to, uint8_t scr_saver) {
 	bool cfg_celsius		= a_cfg.bit_mask & CFG_CELSIUS;
 	a_cfg.off_timeout		= off_timeout;
@@ -491,12 +636,27 @@ void CFG_CORE::setup(uint8_t off_timeout, bool buzzer, bool celsius, bool keep_i
 			a_cfg.gun_temp	= celsiusToFahrenheit(a_cfg.gun_temp);
 		}
 	}
-	a_cfg.bit_mask	= 0;
+	a_cfg.bit_mask	&= CFG_GUN_PREDICT | CFG_GUN_BURST;		// These bits are setup in Hot Air Gun menu
 	if (celsius)	a_cfg.bit_mask |= CFG_CELSIUS;
 	if (buzzer)		a_cfg.bit_mask |= CFG_BUZZER;
 	if (keep_iron)	a_cfg.bit_mask |= CFG_KEEP_IRON;
 	if (reed)		a_cfg.bit_mask |= CFG_SWITCH;
 	if (temp_step)	a_cfg.bit_mask |= CFG_BIG_STEP;
+	if (fast_iron)	a_cfg.bit_mask |= CFG_FAST_IRON;
+}
+
+void CFG_CORE::setGunPredictor(bool use) {
+	if (use)
+		a_cfg.bit_mask |= CFG_GUN_PREDICT;
+	else
+		a_cfg.bit_mask &= ~CFG_GUN_PREDICT;
+}
+
+void CFG_CORE::setGunBurst(bool burst) {
+	if (burst)
+		a_cfg.bit_mask |= CFG_GUN_BURST;
+	else
+		a_cfg.bit_mask &= ~CFG_GUN_BURST;
 }
 
 void CFG_CORE::savePresetTempHuman(uint16_t temp_set) {
@@ -670,6 +830,19 @@ void TIP_CFG::applyTipCalibtarion(uint16_t temp[4], int8_t ambient) {
 	if (tip[i].calibration[3] > int_temp_max) tip[i].calibration[3] = int_temp_max;
 }
 
+void TIP_CFG::applyTipFeedForward(uint8_t ff) {
+	tip[0].mask &= ~TIP_FF_MASK;
+	tip[0].mask |= (ff << TIP_FF_SHIFT) & TIP_FF_MASK;
+}
+
+void TIP_CFG::applyTipPID(const TIP& ltip, bool gun) {
+	uint8_t i = uint8_t(gun);
+	tip[i].Kp				= ltip.Kp;
+	tip[i].Ki				= ltip.Ki;
+	tip[i].Kd				= ltip.Kd;
+	tip[i].boost_lag		= ltip.boost_lag;
+}
+
 // Initialize the tip calibration parameters with the default values
 void TIP_CFG::resetTipCalibration(void) {
 	defaultCalibration(gun_active);
@@ -5,6 +5,7 @@
  *      Author: Alex
  */
 
+#include <stdio.h>
 #include <string.h>
 #include "core.h"
 #include "hw.h"
@@ -13,13 +14,25 @@
 #include "oled.h"
 #include "tools.h"
 #include "buzzer.h"
+#include "oversample.h"
+#include "prof.h"
+#include "ring.h"
+#include "budget.h"
 
 #include "display.h"
 #include <math.h>
 
-#define ADC_CONV 	(4)										// Activated ADC Ranks Number (hadc2.Init.NbrOfConversion)
-#define ADC_LOOPS	(2)										// Number of ADC conversion loops. Should be even
-#define ADC_BUFF_SZ	(2*ADC_CONV*ADC_LOOPS)
+#define ADC_CONV 	(2)										// Activated ADC1 channels in the window (see MX_ADC1_Init())
+#define ADC_LOOPS	(4)										// Number of ADC conversion loops in the window. Should be even
+#define ADC_WINDOW	(2*ADC_CONV*ADC_LOOPS)					// The window size: adc1 and adc2 data interleaved
+#define ADC_BUFF_SZ	(2*ADC_WINDOW)							// Circular DMA buffer holds two windows (halves)
+
+#define IRON_DECIM	(1)										// Windows per IRON temperature (power of 2), 1 means every window
+typedef OVERSAMPLER<ADC_CONV, ADC_LOOPS, IRON_DECIM> ADC_WIN;
+// The ADC channel map of the window, see MX_ADC1_Init() MX_ADC2_Init() in main.c
+const static uint32_t		slot_gun_temp	= ADC1_SLOT(0);
+const static uint32_t		slot_ambient	= ADC1_SLOT(1);
+const static uint32_t		slot_iron_temp	= ADC2_SLOT(0) | ADC2_SLOT(1);
 
 extern ADC_HandleTypeDef	hadc1;
 extern ADC_HandleTypeDef	hadc2;
@@ -27,17 +40,46 @@ extern TIM_HandleTypeDef	htim1;
 extern TIM_HandleTypeDef	htim2;
 extern TIM_HandleTypeDef	htim4;
 
-typedef enum { ADC_IDLE, ADC_CURRENT, ADC_TEMP } t_ADC_mode;
-volatile static t_ADC_mode	adc_mode = ADC_IDLE;
+typedef enum { ADC_IDLE, ADC_TEMP } t_ADC_mode;
+volatile static t_ADC_mode	half_phase[2]	= {ADC_IDLE, ADC_IDLE};	// The window type of each buffer half
+volatile static uint8_t		next_half	= 0;				// The buffer half the next window would be written into
+volatile static bool		adc_busy	= false;			// The ADC window is in progress
+volatile static bool		adc_rearm	= false;			// The ADC and DMA should be restarted
+volatile static uint8_t		adc_busy_cnt	= 0;			// Number of the successive skipped temperature windows
+volatile static uint32_t	adc_stat[ADC_STAT_NUM];			// The ADC statistics, see debug mode
 volatile static uint16_t	buff[ADC_BUFF_SZ];
-volatile static	uint32_t	tim1_cntr	= 0;				// Previous value of TIM1 counter. Using to check the TIM1 value changing
-volatile static	bool		ac_sine		= false;			// Flag indicating that TIM1 is driven by AC power interrupts on AC_ZERO pin
+static PWR_BUDGET			budget;							// The power arbiter of the IRON and the Hot Air Gun
+static BURST				burst;							// The Hot Air Gun burst fire scheduler
+volatile static bool		burst_mode	= false;			// The Hot Air Gun burst fire is active
+volatile static bool		burst_req	= false;			// Requested burst fire mode, applied by TIM1 interrupt
+
+// The temperature window data passed from ADC interrupt to the control task
+typedef struct s_temp_sample {
+	uint16_t	iron;
+	uint16_t	ambient;
+} t_temp_sample;
+static RING<t_temp_sample, 4>	temp_ring;
+static ADC_WIN::DECIMATOR<slot_iron_temp>	iron_decim;	// The IRON temperature is averaged over IRON_DECIM windows
 volatile static uint8_t		check_count	= 1;				// Decrement from check_period to zero by TIM2. When become zero, force to check the IRON connectivity
 
-const static uint16_t  		max_iron_pwm	= 1960;			// Max value should be less than TIM2.CHANNEL3 value by 20
+const static uint16_t		tim2_ticks		= 2000;			// TIM2 period (TIM2.Init.Period + 1)
+const static uint16_t		tim2_prescaler	= 720;			// Nominal TIM2 prescaler (TIM2.Init.Prescaler + 1): 10 mks tick, 50 Hz
+const static uint16_t		temp_settle		= 20;			// Nominal ticks from the IRON PWM end to the temperature window and from the window to the period end
+volatile static uint16_t	max_iron_pwm	= 1960;			// Max value should be less than TIM2.CHANNEL4 value by temp_settle
+volatile static uint8_t		iron_rate		= 0;			// The IRON control loop rate is 50 Hz * 2**iron_rate
+volatile static uint8_t		iron_rate_req	= 0;			// Requested IRON control loop rate, applied by the control task
+volatile static uint8_t		gun_div			= 0;			// Decimate the Hot Air Gun temperature to 50 Hz
+volatile static uint8_t		temp_skip		= 0;			// Number of the next temperature windows to be skipped
+const static uint8_t		max_temp_skip	= 1;			// Successive temperature windows skipped when the IRON temperature is steady, see test/window_skip_sim.cpp
 const static uint16_t  		max_gun_pwm		= 99;			// TIM1 period. Full power can be applied to the HOT GUN
+const static uint16_t		gun_power_slot	= 97;			// TIM1 CH3 compare value to calculate the Hot Air Gun power
 const static uint16_t		check_iron_pwm	= 1;			// This power should be applied to check the current through the IRON
-const static uint8_t		check_period	= 6;			// TIM2 loops between check current through the iron
+const static uint8_t		check_period	= 6;			// TIM2 loops between check current through the connected iron
+const static uint16_t		boot_timeout	= 1000;			// Maximum time to wait for the hardware status at boot (ms)
+const static uint8_t		ac_detect_time	= 60;			// Time to wait for AC_ZERO pulses at boot (ms)
+const static uint8_t		max_adc_busy	= 2;			// Restart the ADC if the temperature windows are skipped successively
+static uint32_t				boot_ready_ms	= 0;			// The time when the working mode has been started (ms since power on)
+volatile static uint32_t	boot_power_ms	= 0;			// The time when the IRON has been powered first time (ms since power on)
 
 static HW		core;										// Hardware core (including all device instances)
 
@@ -55,36 +97,46 @@ static	MTUNE			tune(&core);
 static	MFAIL			fail(&core);
 static	MMBST			boost_setup(&core);
 static	MTPID			pid_tune(&core);
-static	MENU_GUN		gun_menu(&core, &calib_manual, &tune, &pid_tune);
+static	MAUTOPID		auto_pid(&core);
+static	MENU_GUN		gun_menu(&core, &calib_manual, &tune, &pid_tune, &auto_pid);
 static	MWORK_GUN		work_gun(&core);
 static  MABOUT			about(&core);
 static  MDEBUG			debug(&core);
 static	MMENU			main_menu(&core, &boost_setup, &calib_menu, &activate, &tune, &pid_tune, &gun_menu, &about);
 static	MODE*           pMode = &standby_iron;
 
-bool isACsine(void) 	{ return ac_sine; }
+bool 	 isACsine(void) 		{ return core.mains.acPresent(); }
+uint32_t bootReadyTime(void)	{ return boot_ready_ms; }
+uint32_t bootPowerTime(void)	{ return boot_power_ms; }
+uint32_t adcStatistics(t_adc_stat stat)	{ return (stat < ADC_STAT_NUM)?adc_stat[stat]:0; }
+void	 ironFastMode(bool fast)		{ iron_rate_req = fast?1:0; }
+void	 powerBudget(uint16_t watts)	{ budget.init(watts); }
+uint32_t powerStatistics(t_pwr_stat stat)	{ return budget.statistics(stat); }
+void	 gunBurstMode(bool burst)		{ burst_req = burst; }
 
-// Synchronize TIM2 timer to AC power
-uint16_t syncAC(void) {
-	uint32_t to = HAL_GetTick() + 300;						// The timeout
-	uint16_t nxt_tim1	= TIM1->CNT + 2;
-	if (nxt_tim1 > 99) nxt_tim1 -= 99;						// TIM1 is clocked by AC zero crossing signal, period is 99.
-	while (HAL_GetTick() < to) {							// Prevent hang
-		if (TIM1->CNT == nxt_tim1) {
-			TIM2->CNT = 0;									// Synchronize TIM2 to AC power zero crossing signal
-			break;
-		}
-	}
-	// Checking the TIM2 has been synchronized
-	to = HAL_GetTick() + 300;
-	nxt_tim1 = TIM1->CNT + 2;
-	if (nxt_tim1 > 99) nxt_tim1 -= 99;
-	while (HAL_GetTick() < to) {
-		if (TIM1->CNT == nxt_tim1) {
-			return TIM2->CNT;
-		}
-	}
-	return TIM2->ARR+1;										// This value is bigger than TIM2 period, the TIM2 has not been synchronized
+/*
+ * Start both ADCs and circular DMA. HAL starts the first window immediately, it would be tagged by mode
+ * Used at startup and to recover the ADC after error by loop(), never from the interrupts: the HAL calls are slow
+ * and change the ADC and DMA state the interrupts use. While adc_rearm is set, TIM2 interrupt does not start the window
+ */
+static void adcArm(t_ADC_mode mode) {
+	adc_busy		= true;
+	HAL_ADCEx_MultiModeStop_DMA(&hadc1);					// Stop ADC and DMA if they are running
+	HAL_ADC_Stop(&hadc2);
+	half_phase[0]	= mode;
+	half_phase[1]	= ADC_IDLE;
+	next_half		= 1;
+	adc_busy_cnt	= 0;
+	HAL_ADC_Start(&hadc2);									// Start slave ADC first
+	HAL_ADCEx_MultiModeStart_DMA(&hadc1, (uint32_t*)buff, 2*ADC_CONV*ADC_LOOPS);	// Circular DMA, two windows
+	HAL_ADCEx_InjectedStart_IT(&hadc1);						// The current is checked by TIM2 TRGO (OC3REF) in injected mode
+	adc_rearm		= false;
+}
+
+// All the hardware status has been read after power on
+static bool isHWready(uint32_t start_ms) {
+	bool ac_ready = core.mains.acPresent() || (HAL_GetTick() - start_ms >= ac_detect_time);
+	return ac_ready && core.iron.isReady() && core.hotgun.isReady();
 }
 
 void SCRSAVER::reset(void) {
@@ -113,6 +165,10 @@ CFG_STATUS HW::init(void) {
 	iron.load(pp);
 	pp					=	cfg.pidParams(false);			// load Hot Air Gun PID parameters
 	hotgun.load(pp);
+	const GUN_MODEL &gm	=	cfg.gunModel();				// The model identified by the PID autotune, see MAUTOPID
+	hotgun.predictorModel(gm.K, gm.T, gm.L);
+	hotgun.loadFanReference(gm.fan_pwm, gm.fan_cur);		// The fan currents learned with the clear nozzle, see FAN_REG
+	hotgun.usePredictor(cfg.isGunPredictor());
 	buzz.activate(cfg.isBuzzerEnabled());
 	scrsaver.init(cfg.getScrTo());							// Screen saver timeout can be reloaded via main menu, see MMENU::loop()
 	return cfg_init;
@@ -120,14 +176,19 @@ CFG_STATUS HW::init(void) {
 
 extern "C" void setup(void) {
 	CFG_STATUS cfg_init = core.init();						// Initialize the hardware structure before start timers
+	ISR_PROF::init();										// Start the cycle counter to profile the interrupts
+	core.mains.init();										// TIM2 would be synchronized to AC power by AC_ZERO interrupt
+	ironFastMode(core.cfg.isFastIron());					// The IRON control loop rate is applied by the control task
+	powerBudget(core.cfg.powerBudget());
+	gunBurstMode(core.cfg.isGunBurst());
 
 	HAL_ADCEx_Calibration_Start(&hadc1);					// Calibrate both ADCs
 	HAL_ADCEx_Calibration_Start(&hadc2);
+	adcArm(ADC_IDLE);
 	HAL_TIM_PWM_Start(&htim1, TIM_CHANNEL_4);				// PWM signal of Hot Air Gun
 	HAL_TIM_OC_Start_IT(&htim1,  TIM_CHANNEL_3);			// Calculate power of Hot Air Gun interrupt
 	HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_1);				// PWM signal of the IRON
 	HAL_TIM_PWM_Start(&htim2, TIM_CHANNEL_2);				// PWM signal of FAN (Hot Air Gun)
-	HAL_TIM_OC_Start_IT(&htim2,  TIM_CHANNEL_3);			// Check the current through the IRON and FAN, also check ambient temperature
 	HAL_TIM_OC_Start_IT(&htim2,  TIM_CHANNEL_4);			// Calculate power of the IRON
 	HAL_TIM_PWM_Start(&htim4,    TIM_CHANNEL_4);			// PWM signal for the buzzer
 
@@ -145,6 +206,7 @@ extern "C" void setup(void) {
 	fail.setup(&standby_iron, &standby_iron, &standby_iron);
 	boost_setup.setup(&main_menu, &main_menu, &standby_iron);
 	pid_tune.setup(&standby_iron, &standby_iron, &standby_iron);
+	auto_pid.setup(&standby_iron, &standby_iron, &standby_iron);
 	gun_menu.setup(&main_menu, &standby_iron, &standby_iron);
 	main_menu.setup(&standby_iron, &standby_iron, &standby_iron);
 	about.setup(&standby_iron, &standby_iron, &debug);
@@ -163,20 +225,71 @@ extern "C" void setup(void) {
 			core.dspl.errorMessage("EEPROM\nread\nerror");
 			pMode	= &fail;
 			break;
+		case	CFG_OLD_TIPS:								// The old tip area is not converted, the tip PID cannot be saved
+			core.dspl.errorMessage("Too many\ntips\nactive");
+			pMode	= &fail;
+			break;
 		default:
 			break;
 	}
 
-	syncAC();												// Synchronize TIM2 timer to AC power
-	HAL_Delay(1000);										// Wait till hardware status updated
+	uint32_t start_ms = HAL_GetTick();						// Wait till hardware status updated, but not longer than timeout
+	while (HAL_GetTick() - start_ms < boot_timeout) {
+		core.iron.checkSWStatus();
+		core.hotgun.checkSWStatus();
+		if (isHWready(start_ms)) break;
+	}
+	boot_ready_ms = HAL_GetTick();
 	pMode->init();
 }
 
 
+/*
+ * The heater or sensor fault found by the thermal model check (see THERMAL_GUARD). The power of the device is cut already,
+ * show the error. The reported fault is cleared to be checked again: if the heater is still broken, the error would be shown again.
+ * The fault of the other device is kept to be reported next time
+ */
+static bool thermalFault(void) {
+	static const char *fault_msg[4] = { "", "thermal\nrunaway", "no\nheating", "sensor\nfailure" };
+	THERMAL_GUARD::t_fault	iron_fault	= core.iron.thermalFault();
+	THERMAL_GUARD::t_fault	gun_fault	= core.hotgun.thermalFault();
+	if (iron_fault == THERMAL_GUARD::TG_OK && gun_fault == THERMAL_GUARD::TG_OK) return false;
+	char msg[40];
+	if (iron_fault != THERMAL_GUARD::TG_OK) {
+		sprintf(msg, "IRON\n%s", fault_msg[iron_fault]);
+		core.iron.clearFault();
+	} else {
+		sprintf(msg, "Hot Gun\n%s", fault_msg[gun_fault]);
+		core.hotgun.clearFault();
+	}
+	core.dspl.errorMessage(msg);
+	return true;
+}
+
+// The Hot Air Gun fan regulator has learned new reference point, save it to the EEPROM
+static void saveFanReference(void) {
+	if (!core.hotgun.fanReferenceChanged()) return;
+	uint16_t pwm[FAN_REF_POINTS], cur[FAN_REF_POINTS];
+	core.hotgun.dumpFanReference(pwm, cur);
+	core.cfg.saveGunFan(pwm, cur);
+}
+
 extern "C" void loop(void) {
-	static uint32_t AC_check_time = 0;						// Time in ms when to check TIM1 is running
+	if (adc_rearm) {										// The ADC is failed or hung up, see TIM2 interrupt
+		adcArm(ADC_IDLE);									// The next temperature window is started by TIM2 in time
+		++adc_stat[ADC_REARM];
+	}
 	core.iron.checkSWStatus();								// Check status of IRON tilt switches
 	core.hotgun.checkSWStatus();							// Check status of Gun Reed and Mode switches
+	saveFanReference();
+	if (pMode != &fail && thermalFault()) {					// Another fault is shown after the current message
+		core.iron.switchPower(false);
+		core.hotgun.switchPower(false);
+		TIM2->CCR1	= 0;
+		pMode = &fail;
+		pMode->init();
+		return;
+	}
 	MODE* new_mode = pMode->returnToMain();
 	if (new_mode && new_mode != pMode) {
 		core.buzz.doubleBeep();
@@ -195,119 +308,256 @@ extern "C" void loop(void) {
 		pMode = new_mode;
 		pMode->init();
 	}
-
-	// If TIM1 counter has been changed since last check, we received AC_ZERO interrupts from AC power
-	if (HAL_GetTick() >= AC_check_time) {
-		ac_sine		= (TIM1->CNT != tim1_cntr);
-		tim1_cntr	= TIM1->CNT;
-		AC_check_time = HAL_GetTick() + 40;					// 50 Hz is 20 ms
-	}
 }
 
+/*
+ * The ADC DMA runs in the circular mode permanently, see setup().
+ * Both ADCs convert the whole window (ADC_CONV*ADC_LOOPS ranks) by single software trigger and stop,
+ * the DMA writes the window into the next half of the buffer. So, to start new window, just set SWSTART bit.
+ * The window type is saved in the phase tag of the half to be processed by the DMA half/full transfer callback
+ */
 static bool adcStart(t_ADC_mode mode) {
-    if (adc_mode != ADC_IDLE) {								// Not ready to check analog data; Something is wrong!!!
-    	TIM2->CCR1 = 0;										// Switch off the IRON
-    	TIM1->CCR4 = 0;										// Switch off the Hot Air Gun
-		return false;
-    }
-	HAL_ADC_Start(&hadc2);
-    HAL_ADCEx_MultiModeStart_DMA(&hadc1, (uint32_t*)buff, ADC_CONV*ADC_LOOPS);
-	adc_mode = mode;
+	if (adc_busy) return false;								// Previous window is not finished yet, skip this one
+	adc_busy				= true;
+	half_phase[next_half]	= mode;
+	next_half ^= 1;
+	SET_BIT(ADC1->CR2, ADC_CR2_SWSTART);					// ADC2 is a slave in dual regular simultaneous mode
 	return true;
 }
 
+/*
+ * Switch the Hot Air Gun output (TIM1 channel #4) between PWM mode and burst fire mode.
+ * In the burst fire mode the output is forced on or off every half-wave by TIM1 channel #3 interrupt,
+ * the output compare mode is not preloaded, so it is applied immediately
+ */
+static void gunBurst(bool on) {
+	burst.reset();
+	uint32_t ccmr	= TIM1->CCMR2 & ~TIM_CCMR2_OC4M;
+	if (on) {
+		TIM1->CCMR2	= ccmr | (TIM_OCMODE_FORCED_INACTIVE << 8);
+	} else {
+		TIM1->CCMR2	= ccmr | (TIM_OCMODE_PWM1 << 8);
+		TIM1->CCR3	= gun_power_slot;
+	}
+	burst_mode = on;
+}
+
+// Force the Hot Air Gun output in burst fire mode
+static void gunOutput(bool on) {
+	uint32_t ccmr	= TIM1->CCMR2 & ~TIM_CCMR2_OC4M;
+	TIM1->CCMR2		= ccmr | ((on?TIM_OCMODE_FORCED_ACTIVE:TIM_OCMODE_FORCED_INACTIVE) << 8);
+}
+
 /*
  * IRQ handler
- * on TIM1 Output channel #3 to calculate required power for Hot Air Gun
- * on TIM2 Output channel #3 to read the current through the IRON and Fan of Hot Air Gun
- * also check that TIM1 counter changed driven by AC_ZERO interrupt
+ * on TIM1 Output channel #3 to calculate required power for Hot Air Gun.
+ * In the burst fire mode the channel #3 interrupt is moved every half-wave to switch the Hot Air Gun output
  * on TIM2 Output channel #4 to read the IRON, HOt Air Gun and ambient temperatures
+ * When the IRON temperature is steady, the temperature window can be skipped, and the IRON can be powered the whole
+ * next TIM2 period. The IRON power written to TIM2.CCR1 is applied in the next period (preload enabled), so
+ * before the period with temperature window the power is limited by max_iron_pwm here
+ * The current through the IRON and Fan of Hot Air Gun is read by ADC injected channels triggered by TIM2 channel #3
  */
 extern "C" void HAL_TIM_OC_DelayElapsedCallback(TIM_HandleTypeDef *htim) {
+	uint32_t start = ISR_PROF::cycles();
 	if (htim->Instance == TIM1 && htim->Channel == HAL_TIM_ACTIVE_CHANNEL_3) {
-		uint16_t gun_power	= core.hotgun.power();
-		TIM1->CCR4	= constrain(gun_power, 0, max_gun_pwm);
+		uint16_t half_wave = TIM1->CCR3;
+		if (half_wave == gun_power_slot) {
+			uint16_t gun_power	= core.hotgun.power();
+			budget.priority(core.hotgun.isGunReedOpen());	// The Hot Air Gun is in use
+			TIM1->CCR4	= budget.gun(constrain(gun_power, 0, max_gun_pwm));
+			burst.setPower(TIM1->CCR4);
+			if (burst_req != burst_mode)
+				gunBurst(burst_req);
+		}
+		if (burst_mode) {
+			gunOutput(burst.fire(half_wave));
+			TIM1->CCR3 = (half_wave >= max_gun_pwm)?0:half_wave+1;
+		}
 	}
-	if (htim->Instance == TIM2) {
-		if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_3) {
-			if (TIM2->CCR1 || TIM2->CCR2)					// If IRON of Hot Air Gun has been powered
-				adcStart(ADC_CURRENT);
-		} else if (htim->Channel == HAL_TIM_ACTIVE_CHANNEL_4) {
-			adcStart(ADC_TEMP);
+	if (htim->Instance == TIM2 && htim->Channel == HAL_TIM_ACTIVE_CHANNEL_4) {
+		if (temp_skip) {									// Do not read the temperature in this period
+			--temp_skip;
+			++adc_stat[ADC_SKIP];
+			if (temp_skip == 0 && TIM2->CCR1 > max_iron_pwm)	// The temperature would be read in the next period
+				TIM2->CCR1 = max_iron_pwm;
+		} else if (!adc_rearm && adcStart(ADC_TEMP)) {
+			adc_busy_cnt = 0;
+		} else {											// No fresh temperature, cannot calculate the IRON power
+			if (++adc_busy_cnt >= max_adc_busy)				// The ADC is hung up, loop() restarts it
+				adc_rearm = true;
+			++adc_stat[ADC_MISSED];
+			if (TIM2->CCR1) {
+				TIM2->CCR1 = 0;
+				++adc_stat[ADC_CUT];
+			}
 		}
 	}
+	isr_prof[PROF_TIM].update(start);
 }
 
 /*
- * IRQ handler of ADC complete request. The data is in the ADC buffer (buff)
- * Data read by 8 slots interleaved: adc1-rank1, adc2-rank1, adc1-rank2, adc2-rank2, ..., adc1-rank4, adc2-rank4
+ * Read the ADC window data. The data is in the buffer half (data)
+ * Data read by 8 slots interleaved: adc1-rank1, adc2-rank1, adc1-rank2, adc2-rank2, ..., adc1-rank8, adc2-rank8
  * The ADC buffer would have the following fields (see MX_ADC1_Init() MX_ADC2_Init() in main.c)
  * ADC1:			ADC2:
- * iron_current		iron_temp
- * fan_current		iron_temp
  * gun_temp			iron_temp
  * ambient			iron_temp
+ * ... the same ranks repeated ADC_LOOPS times
+ * The averaged temperatures are passed to the control task, that is started by PendSV interrupt
  */
+static void adcProcess(t_ADC_mode mode, volatile uint16_t* data) {
+	if (mode == ADC_TEMP) {									// The window of the temperatures
+		if (TIM2->CNT < TIM2->CCR4)							// The window finished in the next TIM2 period
+			++adc_stat[ADC_LATE];
+		// The Hot Air Gun temperature is read by TIM1.CHANNEL3 interrupt, so it is updated here, at the same priority
+		if (++gun_div >= (1 << iron_rate)) {
+			gun_div = 0;
+			core.hotgun.updateTemp(ADC_WIN::average<slot_gun_temp>(data));	// Apply the power by TIM1.CNANNEL3 interrupt
+		}
+		if (!iron_decim.update(data))						// The IRON temperature is not ready yet
+			return;
+		t_temp_sample sample;
+		sample.iron		= iron_decim.read();				// With ADC_WIN::extra_bits of the fraction
+		sample.ambient	= ADC_WIN::average<slot_ambient>(data);
+		if (temp_ring.push(sample))
+			SCB->ICSR = SCB_ICSR_PENDSVSET_Msk;				// Start the control task
+		else
+			++adc_stat[ADC_FULL];							// The control task is late, the ring is full
+	}
+}
+
+// IRQ handler of DMA half transfer complete: first window of the circular buffer is ready
+extern "C" void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef* hadc) {
+	if (hadc->Instance != ADC1) return;
+	uint32_t start = ISR_PROF::cycles();
+	adcProcess(half_phase[0], buff);
+	adc_busy = false;
+	isr_prof[PROF_ADC].update(start);
+}
+
+// IRQ handler of DMA transfer complete: second window of the circular buffer is ready
 extern "C" void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
 	if (hadc->Instance != ADC1) return;
-	HAL_ADCEx_MultiModeStop_DMA(&hadc1);
-	HAL_ADC_Stop(&hadc2);
-	if (adc_mode == ADC_TEMP) {								// Read the temperatures only, the current should be ignored
-		volatile uint32_t iron_temp	= 0;
-		volatile uint32_t gun_temp	= 0;
-		volatile uint32_t ambient 	= 0;
-		for (uint8_t i = 0; i < ADC_BUFF_SZ; i += 2*ADC_CONV) {
-			iron_temp	+= buff[i+1] + buff[i+3] + buff[i+5] + buff[i+7];
-			gun_temp	+= buff[i+4];
-			ambient		+= buff[i+6];
-		}
-		iron_temp 	+= (ADC_LOOPS*ADC_CONV)/2;				// Round the result
-		iron_temp 	/= ADC_LOOPS*ADC_CONV;
-		gun_temp 	+= ADC_LOOPS/2;							// Round the result
-		gun_temp  	/= ADC_LOOPS;
-		ambient 	+= ADC_LOOPS/2;							// Round the result
-		ambient  	/= ADC_LOOPS;
-		core.iron.updateAmbient(ambient);
+	uint32_t start = ISR_PROF::cycles();
+	adcProcess(half_phase[1], &buff[ADC_WINDOW]);
+	adc_busy = false;
+	isr_prof[PROF_ADC].update(start);
+}
+
+/*
+ * Change the IRON control loop rate: TIM2 runs 2**shift times faster, the PWM frequency increases as well.
+ * The settle time before the temperature window and the window time are kept the same in microseconds.
+ * New prescaler value is loaded by TIM2 on the next update event, the AC PLL reads it on the fly.
+ * The temperature window compare value (CCR4) is preloaded as well, so both are applied at the same update event.
+ * CCR1 is always preloaded, its limit belongs to the next period too
+ */
+static void ironRate(uint8_t shift) {
+	uint16_t settle	= temp_settle << shift;
+	TIM2->CCMR2		|= TIM_CCMR2_OC4PE;						// Load CCR4 at the update event together with PSC
+	TIM2->CR1		|= TIM_CR1_UDIS;						// Do not let the update event load one of them only
+	TIM2->PSC		= (tim2_prescaler >> shift) - 1;
+	TIM2->CCR4		= tim2_ticks - settle;
+	max_iron_pwm	= tim2_ticks - 2*settle;
+	if (TIM2->CCR1 > max_iron_pwm) TIM2->CCR1 = max_iron_pwm;
+	TIM2->CR1		&= ~TIM_CR1_UDIS;
+	core.iron.setRate(shift);
+	iron_rate		= shift;
+}
+
+/*
+ * The Hot Air Gun triac is on in the next TIM2 period, i.e. in the half-waves [CNT, CNT+2] of TIM1.
+ * The triac is on in the first CCR4 half-waves of TIM1 period, the new CCR4 value is preloaded at the TIM1 update.
+ * In the burst fire mode, the scheduler knows the next half-waves
+ */
+static bool gunFiring(void) {
+	if (burst_mode)
+		return burst.isOn() || burst.willFire(2);
+	uint16_t cnt	= TIM1->CNT;
+	uint16_t on		= TIM1->CCR4;
+	if (on == 0) return false;
+	return (cnt < on) || (cnt + 2 > max_gun_pwm);
+}
+
+/*
+ * The control task: calculate the power of the IRON and update the temperatures.
+ * Called by PendSV interrupt having the lowest priority, so it can be preempted by any other interrupt
+ */
+extern "C" void controlTask(void) {
+	uint32_t start = ISR_PROF::cycles();
+	if (iron_rate_req != iron_rate)
+		ironRate(iron_rate_req);
+	t_temp_sample sample;
+	while (temp_ring.pop(sample)) {
+		// The calibration is in ADC units, round off the extra bits of the decimator
+		uint32_t iron_temp	= (sample.iron + ((1 << ADC_WIN::extra_bits) >> 1)) >> ADC_WIN::extra_bits;
+		core.iron.updateAmbient(sample.ambient);
 
 		uint8_t min_iron_pwm = 0;							// By default do not power the IRON to check connectivity
 		if (--check_count == 0) {							// It is time to check IRON is connected or not
-			check_count	= check_period;
+			check_count	= check_period << iron_rate;		// Keep the check period in ms
 			min_iron_pwm = check_iron_pwm;
 		}
+		if (core.iron.isSwapped())							// The tip was removed or inserted, save or restore the controller state
+			core.iron.hotSwap(core.iron.isIronConnected());
 		if (core.iron.isIronConnected()) {
 			uint16_t iron_power = core.iron.power(iron_temp);
-			TIM2->CCR1	= constrain(iron_power, min_iron_pwm, max_iron_pwm);
-
+			uint16_t max_pwm	= max_iron_pwm;
+			// Skip the next temperature windows if the IRON temperature is steady. The Hot Air Gun temperature is read in the same window
+			if (min_iron_pwm == 0 && core.iron.isSteady() && !core.hotgun.isGunConnected()) {
+				temp_skip	= max_temp_skip;
+				max_pwm		= tim2_ticks;					// The IRON can be powered the whole next period
+			}
+			iron_power	= budget.iron(constrain(iron_power, 0, max_pwm), max_pwm, gunFiring());
+			TIM2->CCR1	= constrain(iron_power, min_iron_pwm, max_pwm);
+			if (boot_power_ms == 0 && TIM2->CCR1 > check_iron_pwm)
+				boot_power_ms = HAL_GetTick();
 		} else {
-			TIM2->CCR1	= min_iron_pwm;						// Sometimes supply minimum power to the IRON to check connectivity
-		}
-		core.hotgun.updateTemp(gun_temp);					// Update average Hot Air Gun temperature. Apply the power by TIM1.CNANNEL3 interrupt
-	} else if (adc_mode == ADC_CURRENT) {					// Read the currents, the temperatures should be ignored
-		volatile uint32_t iron_curr	= 0;
-		volatile uint32_t fan_curr 	= 0;
-		for (uint8_t i = 0; i < ADC_BUFF_SZ; i += 2*ADC_CONV) {
-			iron_curr	+= buff[i];
-			fan_curr	+= buff[i+2];
+			TIM2->CCR1	= check_iron_pwm;					// Check every period to detect the inserted tip quickly
 		}
-		iron_curr	+= ADC_LOOPS/2;							// Round the result
-		iron_curr	/= ADC_LOOPS;
-		fan_curr	+= ADC_LOOPS/2;							// Round the result
-		fan_curr	/= ADC_LOOPS;
-
-		if (TIM2->CCR1)										// If IRON has been powered
-			core.iron.updateIronCurrent(iron_curr);
-		if (TIM2->CCR2)										// If Hot Air Gun Fan has been powered
-			core.hotgun.updateFanCurrent(fan_curr);
 	}
-	adc_mode = ADC_IDLE;
+	isr_prof[PROF_CONTROL].update(start);
+}
+
+/*
+ * IRQ handler of ADC injected conversion complete. The injected conversion is triggered by TIM2 TRGO (OC3REF) at the
+ * beginning of the PWM period, so the current is sampled at fixed instant after the PWM front
+ * ADC1 injected ranks: iron_current, fan_current, iron_current, fan_current
+ */
+extern "C" void HAL_ADCEx_InjectedConvCpltCallback(ADC_HandleTypeDef* hadc) {
+	if (hadc->Instance != ADC1) return;
+	__HAL_ADC_ENABLE_IT(hadc, ADC_IT_JEOC);					// HAL disables the interrupt when regular group is triggered by software
+	if (TIM2->CCR1) {										// If IRON has been powered
+		uint32_t iron_curr	= HAL_ADCEx_InjectedGetValue(hadc, ADC_INJECTED_RANK_1) + HAL_ADCEx_InjectedGetValue(hadc, ADC_INJECTED_RANK_3);
+		core.iron.updateIronCurrent((iron_curr+1) >> 1);
+	}
+	if (TIM2->CCR2) {										// If Hot Air Gun Fan has been powered
+		uint32_t fan_curr	= HAL_ADCEx_InjectedGetValue(hadc, ADC_INJECTED_RANK_2) + HAL_ADCEx_InjectedGetValue(hadc, ADC_INJECTED_RANK_4);
+		core.hotgun.updateFanCurrent((fan_curr+1) >> 1);
+	}
+}
+
+// ADC overrun or DMA transfer error. The ADC would be restarted by TIM2 interrupt
+extern "C" void HAL_ADC_ErrorCallback(ADC_HandleTypeDef *hadc) {
+	if (hadc->Instance != ADC1) return;
+	++adc_stat[ADC_ERROR];
+	adc_rearm = true;
 }
 
-extern "C" void HAL_ADC_ErrorCallback(ADC_HandleTypeDef *hadc) 				{ }
 extern "C" void HAL_ADC_LevelOutOfWindowCallback(ADC_HandleTypeDef *hadc) 	{ }
 
 // Encoder Rotated
 extern "C" void EXTI0_IRQHandler(void) {
+	uint32_t start = ISR_PROF::cycles();
 	core.encoder.encoderIntr();
 	__HAL_GPIO_EXTI_CLEAR_IT(ENCODER_L_Pin);
+	isr_prof[PROF_ENCODER].update(start);
 }
 
+// AC power zero crossing (AC_ZERO pin)
+extern "C" void EXTI15_10_IRQHandler(void) {
+	if (__HAL_GPIO_EXTI_GET_IT(AC_ZERO_Pin)) {
+		core.mains.zeroCross();
+		__HAL_GPIO_EXTI_CLEAR_IT(AC_ZERO_Pin);
+	}
+}
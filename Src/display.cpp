@@ -211,6 +211,11 @@ void DSPL::msgReady(void) {
 	status(msg);
 }
 
+void DSPL::msgReadyTime(uint16_t ds) {
+	if (ds > 999) ds = 999;
+	sprintf(msg_buff, "Rdy%2d.%1d", ds/10, ds%10);
+}
+
 void DSPL::msgIdle(void) {
 	static const char *msg = "Idle";
 	status(msg);
@@ -235,6 +240,13 @@ void DSPL::tip(const char *tip_name) {
 	this->tip_name[9] = '\0';
 }
 
+void DSPL::coolTime(uint16_t secs) {
+	if (secs < 100)
+		sprintf(tip_name, "Cool:%2ds", secs);
+	else
+		sprintf(tip_name, "Cool:%2dm", constrain((secs + 30) / 60, 2, 99));
+}
+
 void DSPL::fanSpeed(uint8_t pcnt) {
 	sprintf(tip_name, "Fan:%3d%c", pcnt, '%');
 }
@@ -477,6 +489,12 @@ void DSPL::autoPidCurrentLoop(uint16_t loop, uint32_t period) {
 	sprintf(modified_value, "#%d, P=%ld.%03ds", loop, period/1000, (uint16_t)period%1000);
 }
 
+// Show the identified model: K (units per power * 16), T and L (ms)
+void DSPL::autoPidModel(uint16_t K, uint32_t T, uint32_t L) {
+	default_mode	= HAL_GetTick() + 50000;						// Show new value for 50 seconds, near forever
+	sprintf(modified_value, "K%d.%d T%ld L%ld.%ld", K/16, (K%16)*10/16, (long)(T/1000), (long)(L/1000), (long)((L%1000)/100));
+}
+
 void DSPL::pidPutData(int16_t temp, uint16_t disp) {
 	uint8_t	i 	= data_index;
 	temp 		= constrain(temp, -500, 500);						// Limit graph value
@@ -608,8 +626,8 @@ void DSPL::pidShowGraph(uint8_t pwr) {
 	U8G2::sendBuffer();
 }
 
-void DSPL::pidShowMenu(uint16_t pid_k[3], uint8_t index) {
-	static const char* title = "Tune PID";
+// Show the PID coefficients; index 3 marks the title (the temperature band selector)
+void DSPL::pidShowMenu(uint16_t pid_k[3], uint8_t index, const char *title) {
 	char buff[12];
 
 	U8G2::setFont(u8g_font_profont15r);
@@ -618,6 +636,8 @@ void DSPL::pidShowMenu(uint16_t pid_k[3], uint8_t index) {
 	uint8_t width = U8G2::getStrWidth(title);
 	U8G2::drawStr((d_width-width)/2, 13, title);
 	U8G2::drawHLine((d_width-width)/2, 15, width);
+	if (index == 3)
+		U8G2::drawBitmap(0, 5, 1, 7, bmLeftMark);
 	// Show the Coefficient values
 	for (uint8_t i = 0; i < 3; ++i) {
 		sprintf(buff, k_proto[i], pid_k[i]);
@@ -887,7 +907,7 @@ void DSPL::errorMessage(const char *msg) {
 	}
 }
 
-void DSPL::debugShow(bool gun_mode, uint16_t power, bool iron, bool gun, uint16_t data[4]) {
+void DSPL::debugShow(bool gun_mode, uint16_t power, bool iron, bool gun, uint16_t data[4], uint16_t ac_freq, bool ac_lock) {
 	char buff[14];
 	U8G2::setFont(u8g_font_profont15r);
 	U8G2::clearBuffer();
@@ -898,11 +918,74 @@ void DSPL::debugShow(bool gun_mode, uint16_t power, bool iron, bool gun, uint16_
 		sprintf(buff, "%5d", data[i]);
 		U8G2::drawStr(60,  15*(i+1), buff);
 	}
+	sprintf(buff, "%2d.%1dHz%c", ac_freq/10, ac_freq%10, ac_lock?'*':' ');
+	U8G2::drawStr(0,  45, buff);
 	sprintf(buff, "(%c-%c)", iron?'i':' ', gun?'g':' ');
 	U8G2::drawStr(5,  58, buff);
 	U8G2::sendBuffer();
 }
 
+static const char *isr_name[PROF_NUM] = { "TIM", "ADC", "ENC", "CTL" };
+
+// Show the interrupts execution time in microseconds: min, mean, max
+void DSPL::debugProfile(ISR_PROF prof[], uint8_t size) {
+	char buff[20];
+	U8G2::setFont(u8g_font_profont15r);
+	U8G2::clearBuffer();
+	U8G2::drawStr(0, 11, "us   min  avg  max");
+	for (uint8_t i = 0; i < size && i < PROF_NUM; ++i) {
+		uint16_t t_min	= ISR_PROF::toUs(prof[i].minTime());
+		uint16_t t_avg	= ISR_PROF::toUs(prof[i].meanTime());
+		uint16_t t_max	= ISR_PROF::toUs(prof[i].maxTime());
+		sprintf(buff, "%s %4d %4d %4d", isr_name[i], t_min, t_avg, t_max);
+		U8G2::drawStr(0, 24+13*i, buff);
+	}
+	U8G2::sendBuffer();
+}
+
+// Show the log2 histogram of the interrupt execution time (in cycles)
+void DSPL::debugHistogram(uint8_t index, ISR_PROF *prof) {
+	char buff[20];
+	U8G2::setFont(u8g_font_profont15r);
+	U8G2::clearBuffer();
+	sprintf(buff, "%s log2(cycles)", (index < PROF_NUM)?isr_name[index]:"");
+	U8G2::drawStr(0, 13, buff);
+	uint16_t h_max = prof->histMax();
+	if (h_max == 0) h_max = 1;
+	const uint8_t bar_w	= d_width / PROF_HIST_SZ;
+	const uint8_t bar_h	= d_height - 30;
+	for (uint8_t i = 0; i < PROF_HIST_SZ; ++i) {
+		uint16_t h = prof->hist(i);
+		uint8_t  y = ((uint32_t)h * bar_h + h_max - 1) / h_max;	// Non-zero bar is visible
+		if (y) U8G2::drawBox(i*bar_w, d_height - 14 - y, bar_w-1, y);
+	}
+	for (uint8_t i = 0; i < PROF_HIST_SZ; i += 4) {
+		sprintf(buff, "%d", i);
+		U8G2::drawStr(i*bar_w, d_height, buff);
+	}
+	U8G2::sendBuffer();
+}
+
+// Show the list of named values: up to 4 items in one column or up to 8 short named items in two columns
+void DSPL::debugValues(const char *title, const char *names[], uint32_t values[], uint8_t size) {
+	char buff[20];
+	U8G2::setFont(u8g_font_profont15r);
+	U8G2::clearBuffer();
+	U8G2::drawStr(0, 11, title);
+	U8G2::drawHLine(0, 13, U8G2::getStrWidth(title));
+	if (size > 8) size = 8;
+	for (uint8_t i = 0; i < size; ++i) {
+		if (size <= 4) {
+			sprintf(buff, "%-7s%8ld", names[i], (long)values[i]);
+			U8G2::drawStr(0, 26+12*i, buff);
+		} else {
+			sprintf(buff, "%-4s%5ld", names[i], (long)values[i]);
+			U8G2::drawStr((i & 1)?66:0, 26+12*(i >> 1), buff);
+		}
+	}
+	U8G2::sendBuffer();
+}
+
 void DSPL::showVersion(void) {
 	static const char *title = "About";
 	char buff[30];
@@ -7,6 +7,7 @@
  
 #include <string.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include "eeprom.h"
 #include "iron_tips.h"
 
@@ -48,19 +49,40 @@ bool EEPROM::init(void) {
 
 	if (records == 0) {
 		w_chunk		= r_chunk = 0;
-	    return can_write;
-	}
-
-	r_chunk = max_rec_ch;
-	if (records < cfg_chunks) {								// The EEPROM is not full
-	    w_chunk = r_chunk + 1;
-	    if (w_chunk >= cfg_chunks) w_chunk = 0;
 	} else {
-		w_chunk = min_rec_ch;
+		r_chunk = max_rec_ch;
+		if (records < cfg_chunks) {							// The EEPROM is not full
+			w_chunk = r_chunk + 1;
+			if (w_chunk >= cfg_chunks) w_chunk = 0;
+		} else {
+			w_chunk = min_rec_ch;
+		}
 	}
+	if (can_write)
+		moveOldRecord(records?max_rec_ID:0);
 	return can_write;
 }
 
+/*
+ * The chunks of the configuration area outside the ring were used by the old firmware for configuration records.
+ * If such a chunk keeps the newest record, save it into the ring. The copy gets bigger ID, so it is moved once
+ */
+void EEPROM::moveOldRecord(uint32_t max_rec_ID) {
+	RECORD	rec;
+	bool	found	= false;
+	for (uint16_t chunk = cfg_chunks; chunk < cfg_area; ++chunk) {
+		if (!readChunk(chunk)) return;
+		RECORD* cfg = (RECORD*)data;
+		if (CFG_checkSum(cfg, false) && cfg->ID > max_rec_ID) {
+			max_rec_ID	= cfg->ID;
+			memcpy(&rec, cfg, sizeof(RECORD));
+			found		= true;
+		}
+	}
+	if (found)
+		saveRecord(&rec);
+}
+
 uint16_t EEPROM::tipDataTotal(void) {
 	uint16_t tip_space 		= requiredTipSpace();
 	uint16_t tips_per_chunk = eeprom_chunk_size / tip_space;
@@ -94,12 +116,12 @@ bool EEPROM::saveRecord(RECORD* config_record) {
 
 /*
  * Load tip configuration from EEPROM.
- * As soon one tip record fits to 16 bytes, two tips are saved in one chunk
+ * If the tip PID coefficients are corrupted or the tip area is old, the tip uses the global PID coefficients
  */
 TIP_IO_STATUS EEPROM::loadTipData(TIP* tip, uint8_t tip_chunk_index) {
 	uint16_t tip_space 		= requiredTipSpace();
 	uint16_t tips_per_chunk = eeprom_chunk_size / tip_space;
-	if (tip_chunk_index > tip_chunks * tips_per_chunk)
+	if (tip_chunk_index >= tip_chunks * tips_per_chunk)
 		return EPR_INDEX;
 	uint16_t tip_chunk 		= tip_chunk_index / tips_per_chunk + eeprom_chunks - tip_chunks;
 	uint8_t	 index 			= (tip_chunk_index % tips_per_chunk) * tip_space;
@@ -107,7 +129,11 @@ TIP_IO_STATUS EEPROM::loadTipData(TIP* tip, uint8_t tip_chunk_index) {
 	if (readChunk(tip_chunk)) {								// load whole EEPROM chunk
 		TIP* tmp_tip = (TIP *)&data[index];					// load tip record (first or second)
 		if (TIP_checkSum(tmp_tip, false)) {					// CRC of the tip record is correct
-			memcpy(tip, tmp_tip, sizeof(TIP));				// Copy the tip record from the data buffer
+			memcpy(tip, tmp_tip, tip_space);				// Copy the tip record from the data buffer
+			if (old_tips || !TIP_PIDcheckSum(tip, false)) {
+				tip->Kp = tip->Ki = tip->Kd = 0;
+				tip->boost_lag = 0;
+			}
 			return EPR_OK;
 		}
 		return EPR_CHECKSUM;
@@ -115,30 +141,215 @@ TIP_IO_STATUS EEPROM::loadTipData(TIP* tip, uint8_t tip_chunk_index) {
 	return EPR_IO;
 }
 
+// In the old tip area, the tip PID coefficients are not saved
 TIP_IO_STATUS EEPROM::saveTipData(TIP* tip, uint8_t tip_chunk_index) {
 	uint16_t tip_space 		= requiredTipSpace();
 	uint16_t tips_per_chunk = eeprom_chunk_size / tip_space;
-	if (tip_chunk_index > tip_chunks * tips_per_chunk)
+	if (tip_chunk_index >= tip_chunks * tips_per_chunk)
 		return EPR_INDEX;
 	uint16_t tip_chunk 		= tip_chunk_index / tips_per_chunk + eeprom_chunks - tip_chunks;
 	uint8_t	 index 			= (tip_chunk_index % tips_per_chunk) * tip_space;
 
 	if (readChunk(tip_chunk)) {								// load whole EEPROM chunk
 		TIP* tmp_tip = (TIP *)&data[index];					// choose correct record index (1 or 2)
-		memcpy(tmp_tip, tip, sizeof(TIP));					// Replace tip configuration in the data buffer
+		memcpy(tmp_tip, tip, tip_space);					// Replace tip configuration in the data buffer
 		TIP_checkSum(tmp_tip, true);						// calculate CRC inside the data buffer
+		if (!old_tips)
+			TIP_PIDcheckSum(tmp_tip, true);
 		if (writeChunk(tip_chunk))							// Rewrite whole chunk
 			return EPR_OK;
 	}
 	return EPR_IO;											// Here can be any of IO error: read or write
 }
 
+/*
+ * Convert the tip area of the old firmware: two 16-bytes tip records per chunk without the tip PID coefficients.
+ * The area converted already is marked in the PID gain schedule record, see markTipArea().
+ * All the tip records are read into the memory, then every old record is saved into the free chunk: the chunk
+ * without the records to be converted. So the old records are never overwritten before they are saved in the new format,
+ * and the interrupted conversion is completed on the next start. The old record of the tip that has the new record
+ * is the stale copy. Returns true if the tip area holds the new records only
+ */
+bool EEPROM::migrateTipArea(void) {
+	PID_SCHEDULE sched;
+	old_tips = false;
+	if (loadSchedule(&sched) && sched.tip_layout == 1)		// The tip area has been converted already
+		return true;
+
+	uint16_t first_chunk	= eeprom_chunks - tip_chunks;
+	uint8_t* rec			= (uint8_t*)malloc(tip_chunks * 2 * TIP_OLD_SIZE);	// The first part of all the records
+	uint8_t* rec_chunk		= (uint8_t*)malloc(tip_chunks * 2);	// The chunk of the record, see convertTipArea()
+	bool	 ok				= rec && rec_chunk;
+	uint16_t n				= 0;
+	for (uint16_t chunk = 0; ok && chunk < tip_chunks; ++chunk) {
+		if (!readChunk(first_chunk + chunk)) {
+			ok = false;
+			break;
+		}
+		TIP* tip = (TIP*)data;
+		if (TIP_checkSum(tip, false) && TIP_PIDcheckSum(tip, false)) {
+			memcpy(&rec[n*TIP_OLD_SIZE], data, TIP_OLD_SIZE);
+			rec_chunk[n++] = chunk | tip_rec_new;			// The new tip record
+			continue;
+		}
+		for (uint8_t i = 0; i < eeprom_chunk_size; i += TIP_OLD_SIZE) {
+			tip = (TIP*)&data[i];							// Only the old record fields are checked
+			if (tip->mask > 0 && TIP_checkSum(tip, false)) {
+				memcpy(&rec[n*TIP_OLD_SIZE], tip, TIP_OLD_SIZE);
+				rec_chunk[n++] = chunk;
+			}
+		}
+	}
+	if (ok)
+		ok = convertTipArea(rec, rec_chunk, n);
+	free(rec);
+	free(rec_chunk);
+	return ok;
+}
+
+/*
+ * rec_chunk[i] is the tip area chunk of the record i. tip_rec_new flag marks the new record, tip_rec_done flag marks
+ * the stale old record. The saved record takes the free chunk, the conversion needs one free chunk at least.
+ * If there are more old records, the area is kept in the old format, see isOldTipArea()
+ */
+bool EEPROM::convertTipArea(uint8_t *rec, uint8_t *rec_chunk, uint16_t n) {
+	uint16_t total		= 0;								// The new records
+	uint16_t pending	= 0;								// The old records to be converted
+	for (uint16_t i = 0; i < n; ++i) {
+		if (rec_chunk[i] & tip_rec_new) {
+			++total;
+			continue;
+		}
+		const char *name = ((TIP*)&rec[i*TIP_OLD_SIZE])->name;
+		for (uint16_t j = 0; j < n; ++j) {					// The tip has the new record or it was found before
+			if (j != i && (rec_chunk[j] & tip_rec_new || (j < i && !(rec_chunk[j] & tip_rec_done))) &&
+				strncmp(((TIP*)&rec[j*TIP_OLD_SIZE])->name, name, tip_name_sz) == 0) {
+				rec_chunk[i] |= tip_rec_done;
+				break;
+			}
+		}
+		if (!(rec_chunk[i] & tip_rec_done))
+			++pending;
+	}
+	if (pending > 0 && total + pending >= tip_chunks) {		// Too many tips, keep the old area
+		old_tips = true;
+		return false;
+	}
+
+	for (uint16_t i = 0; i < n; ++i) {
+		if (rec_chunk[i] & (tip_rec_new | tip_rec_done)) continue;
+		uint8_t free_chunk = 0;
+		for ( ; free_chunk < tip_chunks; ++free_chunk) {	// The chunk without the new record and the record to be converted
+			bool used = false;
+			for (uint16_t j = 0; j < n; ++j) {
+				if ((rec_chunk[j] & tip_rec_mask) == free_chunk && !(rec_chunk[j] & tip_rec_done)) {
+					used = true;
+					break;
+				}
+			}
+			if (!used) break;
+		}
+		if (free_chunk >= tip_chunks) return false;		// Cannot happen: one free chunk is left at least
+		TIP tip;
+		memcpy(&tip, &rec[i*TIP_OLD_SIZE], TIP_OLD_SIZE);
+		tip.Kp = tip.Ki = tip.Kd = 0;						// Use the global PID coefficients
+		tip.boost_lag = 0;
+		for (uint8_t k = 0; k < sizeof(tip.reserved); ++k)
+			tip.reserved[k] = 0;
+		if (saveTipData(&tip, free_chunk) != EPR_OK) return false;
+		rec_chunk[i] = free_chunk | tip_rec_new;			// The old chunk does not keep this record any more
+	}
+
+	uint16_t first_chunk = eeprom_chunks - tip_chunks;
+	for (uint8_t chunk = 0; chunk < tip_chunks; ++chunk) {	// Clear the stale old records
+		bool used = false;
+		for (uint16_t j = 0; j < n; ++j) {
+			if (rec_chunk[j] == (chunk | tip_rec_new)) {
+				used = true;
+				break;
+			}
+		}
+		if (used) continue;
+		if (!readChunk(first_chunk + chunk)) return false;
+		bool clear = true;
+		for (uint8_t i = 0; i < eeprom_chunk_size; ++i) {
+			if (data[i] != 0xFF) {
+				clear = false;
+				break;
+			}
+		}
+		if (!clear) {
+			memset(data, 0xFF, eeprom_chunk_size);
+			if (!writeChunk(first_chunk + chunk)) return false;
+		}
+	}
+	return markTipArea();
+}
+
+// Mark the tip area converted in the PID gain schedule record
+bool EEPROM::markTipArea(void) {
+	PID_SCHEDULE sched;
+	if (!loadSchedule(&sched)) {							// The schedule was not saved yet
+		memset(&sched, 0, sizeof(PID_SCHEDULE));
+	}
+	sched.tip_layout = 1;
+	return saveSchedule(&sched);
+}
+
+// Load the PID gain schedule. Returns false if the schedule was never saved
+bool EEPROM::loadSchedule(PID_SCHEDULE* schedule) {
+	return loadSysRecord(sched_chunk, sched_ID, (uint8_t*)schedule, sizeof(PID_SCHEDULE));
+}
+
+bool EEPROM::saveSchedule(PID_SCHEDULE* schedule) {
+	return saveSysRecord(sched_chunk, sched_ID, (uint8_t*)schedule, sizeof(PID_SCHEDULE));
+}
+
+// Load the Hot Air Gun model. Returns false if the model was never saved
+bool EEPROM::loadGunModel(GUN_MODEL* model) {
+	return loadSysRecord(model_chunk, model_ID, (uint8_t*)model, sizeof(GUN_MODEL));
+}
+
+bool EEPROM::saveGunModel(GUN_MODEL* model) {
+	return saveSysRecord(model_chunk, model_ID, (uint8_t*)model, sizeof(GUN_MODEL));
+}
+
+/*
+ * The system record outside the configuration ring starts with 16-bits signature and ends with CRC16 of the record
+ */
+bool EEPROM::loadSysRecord(uint16_t chunk, uint16_t ID, uint8_t* rec, uint8_t size) {
+	if (readChunk(chunk)) {
+		uint16_t *s_ID	= (uint16_t*)data;
+		uint16_t *s_crc	= (uint16_t*)&data[size - sizeof(uint16_t)];
+		uint16_t crc = *s_crc;
+		*s_crc = 0;
+		bool ok = (*s_ID == ID) && (crc == dataCRC(data, size));
+		*s_crc = crc;
+		if (ok) {
+			memcpy(rec, data, size);
+			return true;
+		}
+	}
+	return false;
+}
+
+bool EEPROM::saveSysRecord(uint16_t chunk, uint16_t ID, uint8_t* rec, uint8_t size) {
+	if (!can_write) return can_write;
+
+	uint16_t *s_ID	= (uint16_t*)rec;
+	uint16_t *s_crc	= (uint16_t*)&rec[size - sizeof(uint16_t)];
+	*s_ID	= ID;
+	*s_crc	= 0;
+	*s_crc	= dataCRC(rec, size);
+	memcpy(data, rec, size);
+	return writeChunk(chunk);
+}
 
 // Clear bottom area of the EEPROM, where the configuration data is
 void EEPROM::clearConfigArea(void) {
 	for (uint8_t i = 0; i < eeprom_chunk_size; ++i)
 		data[i] = 0xFF;
-	for (int i = 0; i < cfg_chunks; ++i) {
+	for (int i = 0; i <= sched_chunk; ++i) {				// Clear the PID gain schedule as well
 		uint32_t addr = i * eeprom_chunk_size;
 		if (HAL_I2C_Mem_Write(hi2c, eeprom_address<<1, addr, I2C_MEMADD_SIZE_16BIT, data, eeprom_chunk_size, 100) != HAL_OK) {
 			break;											// Stop writing immediately in case of error
@@ -150,6 +361,7 @@ void EEPROM::clearConfigArea(void) {
 
 // Calculate the space required to store TIP configuration. (defined in config.h). The space size should be multiple by 2**N
 uint16_t EEPROM::requiredTipSpace(void) {
+	if (old_tips) return TIP_OLD_SIZE;						// Two old records per chunk
 	uint16_t tip_sz = sizeof(TIP);
 	for (long i = 1; i <= eeprom_chunk_size; i <<= 1) {
 		if (i >= tip_sz) {
@@ -201,6 +413,20 @@ uint8_t EEPROM::CFG_checkSum(RECORD* cfg, bool write) {
 	return res;
 }
 
+/*
+ * CRC-16/CCITT of the data, every byte and bit changes the result. The shifted summary used by the configuration record
+ * loses the bytes older than 16 positions. Start with 0xFFFF to avoid good CRC with all-zero
+ */
+uint16_t EEPROM::dataCRC(uint8_t* d, uint8_t size) {
+	uint16_t crc = 0xFFFF;
+	for (uint8_t i = 0; i < size; ++i) {
+		crc ^= (uint16_t)d[i] << 8;
+		for (uint8_t b = 0; b < 8; ++b)
+			crc = (crc & 0x8000)?((crc << 1) ^ 0x1021):(crc << 1);
+	}
+	return crc;
+}
+
 // Checks the CRC inside tip structure. Returns true if OK, replaces the CRC with the correct value
 uint8_t EEPROM::TIP_checkSum(TIP* tip, bool write) {
 	uint32_t summ = tip->t200;
@@ -217,3 +443,14 @@ uint8_t EEPROM::TIP_checkSum(TIP* tip, bool write) {
 	if (write) tip->crc = summ & 0xFF;
 	return res;
 }
+
+// Checks the tip PID signature and the checksum of the whole tip record. Returns true if OK, replaces them with the correct values
+bool EEPROM::TIP_PIDcheckSum(TIP* tip, bool write) {
+	uint16_t summ = dataCRC((uint8_t*)tip, offsetof(TIP, pid_crc));
+	bool res = (tip->pid_ID == tip_pid_ID) && (tip->pid_crc == summ);
+	if (write) {
+		tip->pid_ID		= tip_pid_ID;
+		tip->pid_crc	= dataCRC((uint8_t*)tip, offsetof(TIP, pid_crc));
+	}
+	return res;
+}
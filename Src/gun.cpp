@@ -9,7 +9,7 @@
 
 void HOTGUN_HW::init(void) {
 	c_fan.init(sw_avg_len,		fan_off_value,	fan_on_value);
-	sw_gun.init(sw_avg_len,		sw_off_value, 	sw_on_value);
+	sw_gun.init(sw_avg_len,		sw_off_value, 	sw_on_value, 0, true);
 	activateRelay(false);
 }
 
@@ -21,6 +21,14 @@ void HOTGUN_HW::checkSWStatus(void) {
 	}
 }
 
+/*
+ * The connection is checked by the fan current, so it is known only when the fan is powered.
+ * At boot the fan is off, the Hot Air Gun connection is checked when the fan starts
+ */
+bool HOTGUN_HW::isReady(void) {
+	return sw_gun.settled() && (c_fan.settled() || TIM2->CCR2 == 0);
+}
+
 /*
  * We need some time to activate the relay, so we initialize the relay_ready_cnt variable.
  *
@@ -35,6 +43,129 @@ void HOTGUN_HW::activateRelay(bool activate) {
 	}
 }
 
+void SMITH::model(uint16_t k, uint16_t t, uint8_t l) {
+	K	= k;
+	T	= constrain(t, 1, 1000);
+	L	= constrain(l, 0, max_delay);
+	reset();
+}
+
+void SMITH::reset(void) {
+	t_model		= 0;
+	t_delayed	= 0;
+	index		= 0;
+	for (uint8_t i = 0; i < sizeof(pwr); ++i)
+		pwr[i] = 0;
+}
+
+void SMITH::update(uint16_t power) {
+	pwr[index]	= power;
+	uint8_t	 d	= (index + sizeof(pwr) - L) % sizeof(pwr);	// The power applied L periods ago
+	if (++index >= sizeof(pwr)) index = 0;
+	t_model		+= ((int32_t)K * power * 16 - t_model) / T;
+	t_delayed	+= ((int32_t)K * pwr[d] * 16 - t_delayed) / T;
+}
+
+void FAN_REG::start(uint16_t preset) {
+	this->preset	= preset;
+	out				= (int32_t)preset << 4;
+	ref				= reference(preset);					// 0 if new reference point should be learned
+	settle			= settle_periods;
+	fault_cnt		= 0;
+	failed			= false;
+}
+
+uint16_t FAN_REG::pwm(int32_t current) {
+	if (settle) {											// Wait till the fan settles at the preset speed
+		if (--settle == 0 && ref == 0 && current > 0) {		// Learn new reference point
+			ref = current;
+			for (uint8_t i = 0; i < FAN_REF_POINTS; ++i) {
+				if (ref_cur[i] == 0) {
+					ref_pwm[i]	= preset;
+					ref_cur[i]	= current;
+					ref_changed	= true;
+					break;
+				}
+			}
+		}
+		return preset;
+	}
+	if (ref <= 0) return preset;
+	if (current * 100 < ref * min_current_pcnt || current * 100 > ref * max_current_pcnt) {
+		if (fault_cnt < fault_periods) ++fault_cnt;
+		if (fault_cnt >= fault_periods)
+			failed = true;
+		return out >> 4;									// Do not correct the speed by wrong current
+	}
+	fault_cnt	= 0;
+	int32_t low	= preset * 3 / 4;							// Limit the correction
+	int32_t high= preset * 3 / 2;
+	if (high > max_fan) high = max_fan;
+	out	+= (ref - current) << 2;							// Integral regulator, gain 1/4
+	out	= constrain(out, low << 4, high << 4);
+	return out >> 4;
+}
+
+/*
+ * The reference current is interpolated between the learned points around the speed. Out of the learned range,
+ * the current of the nearest point is scaled by the speed. If the speed is out of the learned range, no point is close
+ * to the speed and there is a free one, the new point should be learned
+ */
+int32_t FAN_REG::reference(uint16_t speed) {
+	int8_t	lo = -1, hi = -1;									// The nearest points below and above the speed
+	bool	near = false, spare = false;
+	for (uint8_t i = 0; i < FAN_REF_POINTS; ++i) {
+		if (ref_cur[i] == 0) {
+			spare = true;
+			continue;
+		}
+		if (abs((int32_t)ref_pwm[i] - (int32_t)speed) <= learn_dist) near = true;
+		if (ref_pwm[i] <= speed && (lo < 0 || ref_pwm[i] > ref_pwm[lo])) lo = i;
+		if (ref_pwm[i] >= speed && (hi < 0 || ref_pwm[i] < ref_pwm[hi])) hi = i;
+	}
+	if (lo >= 0 && hi >= 0) {
+		if (ref_pwm[hi] == ref_pwm[lo]) return ref_cur[lo];
+		return map(speed, ref_pwm[lo], ref_pwm[hi], ref_cur[lo], ref_cur[hi]);
+	}
+	if (lo < 0 && hi < 0) return 0;
+	if (!near && spare) return 0;
+	uint8_t n = (lo >= 0)?lo:hi;
+	return ((int32_t)ref_cur[n] * speed + ref_pwm[n]/2) / ref_pwm[n];
+}
+
+void FAN_REG::loadReference(const uint16_t pwm[FAN_REF_POINTS], const uint16_t cur[FAN_REF_POINTS]) {
+	for (uint8_t i = 0; i < FAN_REF_POINTS; ++i) {
+		ref_pwm[i]	= pwm[i];
+		ref_cur[i]	= pwm[i]?cur[i]:0;
+	}
+	ref_changed = false;
+}
+
+void FAN_REG::dumpReference(uint16_t pwm[FAN_REF_POINTS], uint16_t cur[FAN_REF_POINTS]) {
+	for (uint8_t i = 0; i < FAN_REF_POINTS; ++i) {
+		pwm[i]	= ref_pwm[i];
+		cur[i]	= ref_cur[i];
+	}
+}
+
+// The nozzle was cleaned: learn the reference points again
+void FAN_REG::clearReference(void) {
+	for (uint8_t i = 0; i < FAN_REF_POINTS; ++i) {
+		ref_pwm[i]	= 0;
+		ref_cur[i]	= 0;
+	}
+	ref		= 0;
+	settle	= 0;
+	ref_changed = true;
+}
+
+uint8_t FAN_REG::referencePoints(void) {
+	uint8_t n = 0;
+	for (uint8_t i = 0; i < FAN_REF_POINTS; ++i)
+		if (ref_cur[i]) ++n;
+	return n;
+}
+
 void HOTGUN::init(void) {
 	mode		= POWER_OFF;								// Completely stopped, no power on fan also
 	fan_speed	= 0;
@@ -44,7 +175,9 @@ void HOTGUN::init(void) {
     h_power.reset();
 	h_temp.reset();
 	d_power.length(ec);
-	PID::init(13);											// Initialize PID for Hot Air Gun
+	cool_k.length(cool_k_len);
+	cool_model	= false;
+	PID::init();											// Initialize PID for Hot Air Gun
     resetPID();
 }
 
@@ -74,8 +207,20 @@ uint16_t HOTGUN::alternateTemp(void) {
 	return t;
 }
 
+void HOTGUN::setFan(uint16_t fan) {
+	fan = constrain(fan, min_working_fan, max_fan_speed);
+	if (fan != fan_speed)
+		fan_reg.start(fan);									// Regulate new fan speed
+	fan_speed = fan;
+}
+
 void HOTGUN::switchPower(bool On) {
 	fan_off_time = 0;										// Disable fan offline by timeout
+	cool_prev	 = 0;										// Start learning the cooling model from new period
+	cool_skip	 = cool_skip_len;
+	cool_fresh	 = true;
+	cool_lost	 = false;
+	if (On) fan_reg.start(fan_speed);
 	switch (mode) {
 		case POWER_OFF:
 			if (fanSpeed() == 0) {							// No power supplied to the Fan
@@ -104,10 +249,14 @@ void HOTGUN::switchPower(bool On) {
 			}
 			break;
 		case POWER_ON:
+		case POWER_PID_TUNE:
 			if (!On) {
 				mode = POWER_COOLING;
 				activateRelay(false);						// Switch off the AC relay
 				fan_off_time = HAL_GetTick() + fan_off_timeout;
+			} else if (mode == POWER_PID_TUNE) {			// Finish the PID tuning, keep the temperature by PID
+				mode = POWER_ON;
+				resetPID();
 			}
 			break;
 		case POWER_FIXED:
@@ -163,6 +312,19 @@ void HOTGUN::switchPower(bool On) {
 	d_power.reset();
 }
 
+/*
+ * Start the relay method PID tuning. The Hot Air Gun should be working (POWER_ON) and keep the base temperature.
+ * The relay switches the power between base_pwr + delta_power and base_pwr - delta_low on every crossing of base_temp +- temp.
+ * The oscillation period is measured in ms, so it does not depend on the TIM1 period (the AC frequency)
+ */
+void HOTGUN::autoTunePID(uint16_t base_pwr, uint16_t delta_power, uint16_t base_temp, uint16_t temp, uint16_t delta_low) {
+	if (mode != POWER_ON) return;
+	mode = POWER_PID_TUNE;
+	h_power.reset();
+	d_power.reset();
+	PIDTUNE::start(base_pwr, delta_power, base_temp, temp, delta_low);
+}
+
 void HOTGUN::fixPower(uint8_t Power) {
     if (Power == 0) {										// To switch off the hot gun, set the Power to 0
         switchPower(false);
@@ -177,13 +339,23 @@ void HOTGUN::fixPower(uint8_t Power) {
 
 /*
  * Called from HAL_TIM_OC_DelayElapsedCallback() event handler. see core.cpp
- * 100 times per second
+ * once per TIM1 period (100 AC_ZERO pulses)
  */
 uint16_t HOTGUN::power(void) {
 	uint16_t t = h_temp.read();								// Actual Hot Air Gun temperature
+	uint32_t now = HAL_GetTick();
+	if (last_power_ms && now - last_power_ms < 2000)		// Measure the TIM1 period to predict the cooling time
+		period_ms = now - last_power_ms;
+	last_power_ms = now;
+	if (isGunConnected()) {									// Compare the temperature rate with the power applied (granted)
+		bool heating = (mode == POWER_ON) && !chill && (t + guard_heating < temp_set);
+		guard.check(t, t, appliedPower(), heating);
+	} else {
+		guard.reset();
+	}
 
 	if ((t >= int_temp_max + 100) || (t > (temp_set + 400))) {	// Prevent global over heating
-		if (mode == POWER_ON) chill = true;					// Turn off the power in main working mode only;
+		if (mode == POWER_ON || mode == POWER_PID_TUNE) chill = true; // Turn off the power in main working mode only;
 	}
 
 	int32_t		p = 0;
@@ -191,7 +363,8 @@ uint16_t HOTGUN::power(void) {
 		case POWER_OFF:
 			break;
 		case POWER_ON:
-			TIM2->CCR2	= fan_speed;
+			TIM2->CCR2	= fan_reg.pwm(fanCurrent());
+			if (fan_reg.isFailed()) break;					// Do not heat without airflow
 			if (chill) {
 				if (t < (temp_set - 2)) {
 					chill = false;
@@ -203,7 +376,10 @@ uint16_t HOTGUN::power(void) {
 			if (relay_ready_cnt > 0) {						// Relay is not ready yet
 				--relay_ready_cnt;							// Do not apply power to the HOT GUN till AC relay is ready
 			} else {
-				p = PID::reqPower(temp_set, t);
+				int32_t t_fb = t;
+				if (predictor)								// The temperature expected after the dead time
+					t_fb = constrain(t + smith.correction(), 0, int_temp_max + 400);
+				p = reqPower(temp_set, t_fb);
 				p = constrain(p, 0, max_power);
 			}
 			break;
@@ -216,6 +392,16 @@ uint16_t HOTGUN::power(void) {
 			}
 			TIM2->CCR2	= fan_speed;
 			break;
+		case POWER_PID_TUNE:
+			TIM2->CCR2	= fan_speed;
+			if (chill) break;								// Over heating: no power till the tuning is finished
+			if (relay_ready_cnt > 0) {						// Relay is not ready yet
+				--relay_ready_cnt;							// Do not apply power to the HOT GUN till AC relay is ready
+			} else {
+				p = PIDTUNE::run(t);
+				p = constrain(p, 0, max_power);
+			}
+			break;
 		case POWER_COOLING:
 			if (TIM2->CCR2 < min_fan_speed) {
 				shutdown();
@@ -224,11 +410,19 @@ uint16_t HOTGUN::power(void) {
 					if (isCold()) {							// FAN && connected && cold
 						shutdown();
 					} else {								// FAN && connected && !cold
-						uint16_t fan = map(h_temp.read(), temp_gun_cold, temp_set, max_cool_fan, min_fan_speed);
-						fan = constrain(fan, min_fan_speed, max_fan_speed);
-						TIM2->CCR2 = fan;
+						TIM2->CCR2 = coolFan(t);
+						cool_lost = false;
 					}
 				} else {									// FAN && !connected
+					if (!cool_lost) {						// Do not blow the fan longer than the model predicts
+						cool_lost = true;
+						uint32_t ms = coolTime(cool_prev);
+						if (ms) {
+							ms = constrain(2*ms, min_fan_off, fan_off_timeout);
+							if (fan_off_time == 0 || now + ms < fan_off_time)
+								fan_off_time = now + ms;
+						}
+					}
 					if (fan_off_time) {						// The fan should be turned off in specific time
 						if (HAL_GetTick() < fan_off_time)	// It is not time to shutdown the fan
 							break;
@@ -244,6 +438,13 @@ uint16_t HOTGUN::power(void) {
 
 	// Only supply the power to the heater if the Hot Air Gun is connected
 	if (TIM2->CCR2 < min_fan_speed || !isGunConnected()) p = 0;
+	if (guard.fault()) p = 0;								// The heater or the sensor is broken, see MFAIL mode
+	if (predictor) {
+		if (mode == POWER_ON)
+			smith.update(p);
+		else
+			smith.reset();
+	}
 	h_power.update(p);
 	int32_t	ap	= h_power.average(p);
 	int32_t	diff 	= ap - p;
@@ -258,8 +459,110 @@ uint8_t	HOTGUN::presetFanPcnt(void) {
 
 }
 
+/*
+ * The cooling model: the temperature drop per period is proportional to the temperature and the fan speed,
+ * the coefficient is learned while cooling. The fan speed is selected to keep the temperature drop at the maximum
+ * safe rate for the heater: when the Hot Air Gun is hot, the fan is slower, then it reaches the maximum speed.
+ * Till the model is learned, the fan speed follows the linear profile of the temperature. The thermocouple lags the heater,
+ * so the model is not learned at the beginning of cooling. The fan does not speed up till the model is learned
+ * in this cooldown, then it speeds up slowly to limit the model error
+ */
+uint16_t HOTGUN::coolFan(uint16_t t) {
+	uint16_t fan = TIM2->CCR2;
+	if (cool_skip) {
+		--cool_skip;										// The measured drop is less than the heater one yet
+	} else if (cool_prev && cool_prev >= t && t > temp_gun_cold && fan >= min_fan_speed) {
+		uint32_t k = ((uint64_t)(cool_prev - t) << 32) / ((uint32_t)t * fan);
+		if (cool_k.updates() == 0 || cool_fresh)			// The airflow is not proportional to the fan speed: learn k near the speed
+			cool_k.init(k);
+		else
+			cool_k.update(k);
+		if (cool_k.updates() >= cool_k_min) cool_model = true;
+		cool_fresh = false;
+	}
+	cool_prev = t;
+	int32_t k = cool_k.read();
+	uint32_t f = 0;
+	if (cool_model && k > 0)
+		f = ((uint64_t)max_cool_grad << 32) / ((uint64_t)k * t);
+	else
+		f = map(t, temp_gun_cold, temp_set, max_cool_fan, min_fan_speed);
+	if ((cool_fresh || !cool_model) && f > fan) f = fan;	// No model or the model was learned at other fan speed
+	if (f > fan + max_cool_step) f = fan + max_cool_step;	// The model error should not chill the heater at once
+	return constrain(f, min_fan_speed, max_fan_speed);
+}
+
+// Apply the cooling model with the fan profile of coolFan() till the Hot Air Gun is cold
+uint32_t HOTGUN::coolTime(int32_t t) {
+	int32_t k = cool_k.read();
+	if (!cool_model || k <= 0 || t <= temp_gun_cold) return 0;
+	uint32_t periods = 0;
+	t <<= 8;												// Keep the fraction part of the temperature
+	while (t > (temp_gun_cold << 8) && periods < 3600) {
+		int32_t drop = ((uint64_t)k * t * max_fan_speed) >> 32;
+		if (drop > (max_cool_grad << 8)) drop = max_cool_grad << 8;
+		if (drop < 1) drop = 1;
+		t -= drop;
+		++periods;
+	}
+	return periods * period_ms;
+}
+
+uint16_t HOTGUN::timeToCold(void) {
+	if (mode != POWER_COOLING || !isGunConnected()) return 0;
+	uint32_t ms = coolTime(h_temp.read());
+	return (ms + 500) / 1000;
+}
+
 void HOTGUN::shutdown(void)	{
 	mode = POWER_OFF;
 	TIM2->CCR2 = 0;
 	activateRelay(false);
 }
+
+bool BURST::isSpread(uint16_t half_waves) {
+	if (half_waves > 2 && half_waves <= spread_edge) return true;
+	if (half_waves + spread_edge >= period && half_waves + 2 < period) return true;
+	return (half_waves + spread_mid >= period/2) && (half_waves <= period/2 + spread_mid);
+}
+
+bool BURST::fire(uint16_t half_wave) {
+	if (half_wave == 0) {									// New TIM1 period
+		spread	= isSpread(power);
+		block	= power;
+	}
+	if (!spread) {											// The contiguous block as in the PWM mode
+		on = half_wave < block;
+	} else if ((half_wave & 1) == 0) {						// New AC period
+		acc	+= power;
+		on	= (acc >= period);
+		if (on) acc -= period;
+	}
+	next = half_wave + 1;
+	if (next >= period) next = 0;
+	return on;
+}
+
+bool BURST::willFire(uint8_t n) {
+	uint16_t a	= acc;
+	bool	 o	= on;
+	uint16_t h	= next;
+	bool	 s	= spread;
+	uint16_t b	= block;
+	for (uint8_t i = 0; i < n; ++i) {
+		if (h == 0) {
+			s	= isSpread(power);
+			b	= power;
+		}
+		if (!s) {
+			o	= h < b;
+		} else if ((h & 1) == 0) {
+			a	+= power;
+			o	= (a >= period);
+			if (o) a -= period;
+		}
+		if (o) return true;
+		if (++h >= period) h = 0;
+	}
+	return false;
+}
@@ -10,10 +10,21 @@
 #include "tools.h"
 
 void IRON_HW::init(void) {
-	t_iron_short.length(iron_emp_coeff);
+	t_iron.reset();
 	t_amb.length(ambient_emp_coeff);
-	c_iron.init(iron_sw_len,	iron_off_value,	iron_on_value);
-	sw_iron.init(sw_tilt_len,	sw_off_value, 	sw_on_value);
+	c_iron.init(iron_sw_len,	iron_off_value,	iron_on_value, iron_sw_fast, true);
+	sw_iron.init(sw_tilt_len,	sw_off_value, 	sw_on_value, 0, true);
+}
+
+void IRON_HW::updateAmbient(uint32_t value) {
+	if (t_amb.updates() == 0)								// Do not wait for exponential average to reach the value
+		t_amb.init(value);
+	else
+		t_amb.update(value);
+}
+
+bool IRON_HW::isReady(void) {
+	return c_iron.settled() && sw_iron.settled() && t_amb.updates() > 0;
 }
 
 /*
@@ -75,19 +86,29 @@ void IRON::init(void) {
 	h_temp.length(ec);
 	d_power.length(ec);
 	d_temp.length(ec);
+	ff_learn.length(ff_emp_coeff);
 	PID::init();											// Initialize PID for IRON
 	resetPID();
 }
 
 void IRON::switchPower(bool On) {
+	boost			= false;
 	if (!On) {
 		fix_power	= 0;
 		if (mode != POWER_OFF)
 			mode = POWER_COOLING;							// Start the cooling process
 	} else {
-		resetPID();
+		if (resumed_set != temp_set)						// Keep the PID state of the inserted warm tip
+			resetPID();
+		resumed_set	= 0;
 		temp_low	= 0;									// Disable low power mode
 		mode		= POWER_ON;
+		if (boost_req && temp_curr + boost_min < temp_set) {
+			boost		= true;
+			boost_end	= HAL_GetTick() + boost_max_time;
+			boost_n		= 0;								// Identify the tip heat lag, see identifyLag()
+		}
+		boost_req	= false;
 	}
 	h_power.reset();
 	d_power.reset();
@@ -108,8 +129,14 @@ uint16_t IRON::alternateTemp(void) {
 	return t;
 }
 
+bool IRON::isSteady(void) {
+	if (mode != POWER_ON || chill) return false;
+	int32_t t_set = temp_low?temp_low:temp_set;
+	return (abs(h_temp.read() - t_set) <= steady_temp) && (d_temp.read() <= steady_disp);
+}
+
 void IRON::setTemp(uint16_t t) {
-	if (mode == POWER_ON) resetPID();
+	if (mode == POWER_ON && ff_k == 0) resetPID();			// With the feedforward, the PID history keeps the model error only
 	if (t > int_temp_max) t = int_temp_max;					// Do not allow over heating. int_temp_max is defined in vars.cpp
 	temp_set = t;
 	uint16_t ta = h_temp.read();
@@ -159,8 +186,18 @@ void IRON::adjust(uint16_t t) {
 }
 
 uint16_t IRON::power(int32_t t) {
-	t				= tempShortAverage(t);					// Prevent temperature deviation using short term history average
+	if (resume_check) {
+		resume_check = false;
+		resume(t);
+	}
+	int32_t t_raw	= t;
+	int32_t applied	= TIM2->CCR1;							// The power granted for the measured period, it can be cut by PWR_BUDGET
+	t				= tempEstimate(t, applied);				// Filter the temperature using the power as the control input
+	if (t < 0) t = 0;
 	temp_curr		= t;
+	int32_t t_set	= temp_low?temp_low:temp_set;
+	bool heating	= (mode == POWER_ON) && !chill && (t + guard_heating < t_set);
+	guard.check(t, t_raw, applied, heating);				// Compare the temperature rate with the applied power
 	int32_t at 		= h_temp.average(temp_curr);
 	int32_t diff	= at - temp_curr;
 	d_temp.update(diff*diff);
@@ -174,8 +211,10 @@ uint16_t IRON::power(int32_t t) {
 		case POWER_OFF:
 			break;
 		case POWER_COOLING:
-			if (at < iron_cold)
-				mode = POWER_OFF;
+			if (at < iron_cold) {
+				mode		= POWER_OFF;
+				resumed_set	= 0;							// The tip has cooled down, the saved PID state is not valid
+			}
 			break;
 		case POWER_ON:
 		{
@@ -189,8 +228,38 @@ uint16_t IRON::power(int32_t t) {
 					break;
 				}
 			}
-			p = PID::reqPower(t_set, t);
+			/*
+			 * Boost: full power till the temperature predicted by the tip model reaches the preset one.
+			 * The heater is ahead of the measured temperature by the rate times the heat lag of the tip, so the
+			 * temperature keeps rising for the lag time after the cutoff. The lag is identified by the boost power
+			 * step and the learned power to rate gain, see identifyLag(); boost_lead is used while the lag is not learned.
+			 * The learned feedforward power is used by the PID after the hand over
+			 */
+			if (boost) {
+				identifyLag(t_raw, applied);
+				int32_t lead	= boost_lag?(boost_lag * 20):boost_lead;	// ms
+				int32_t t_pred	= t + (tempRate() * lead) / 1000;
+				if (t_pred < t_set && HAL_GetTick() < boost_end) {
+					p = max_power;
+					break;
+				}
+				boost = false;
+				resetPID();									// Hand over to the PID with the feedforward power
+			}
+			if (ff_k)
+				PID::feedForward((ff_k * t_set + (1 << (ff_shift-1))) >> ff_shift);
+			else
+				PID::feedForward(0);
+			p = reqPower(t_set, t);
 			p = constrain(p, 0, max_power);
+			resumed_set	= 0;
+			if (isSteady() && t_set > 0) {					// Learn the power required to keep the temperature
+				int32_t k = (h_power.read() << ff_shift) / t_set;
+				if (ff_learn.updates() == 0)
+					ff_learn.init(k);
+				else
+					ff_learn.update(k);
+			}
 			break;
 		}
 		case POWER_FIXED:
@@ -202,6 +271,7 @@ uint16_t IRON::power(int32_t t) {
 		default:
 			break;
 	}
+	if (guard.fault()) p = 0;								// The heater or the sensor is broken, see MFAIL mode
 
 	int32_t	ap		= h_power.average(p);
 	diff 			= ap - p;
@@ -211,13 +281,161 @@ uint16_t IRON::power(int32_t t) {
 
 void IRON::reset(void) {
 	resetShortTemp();
+	guard.reset();
+	boost_req	= false;
+	boost		= false;
 	h_power.reset();
 	h_temp.reset();
 	d_power.reset();
 	d_temp.reset();
 	mode = POWER_OFF;										// New tip inserted, clear COOLING mode
+	resumed_set	= 0;
 }
 
+void IRON::selectTip(uint8_t index) {
+	if (index == tip_id) return;
+	tip_id	= index;
+	boost_lag	= 0;										// The heat lag of the new tip is loaded from its record
+	reset();
+	resume_check = true;									// The state of the tip can be saved when it was removed
+}
+
+/*
+ * Called by the control task as soon as the IRON connection changed, see IRON_HW::isSwapped().
+ * The state of the removed tip is saved into the free or the oldest slot. The inserted tip is checked
+ * by the first temperature measurement in power(): neither the power() nor the filters run while the tip is removed
+ */
+void IRON::hotSwap(bool connected) {
+	if (connected) {
+		resume_check = true;
+		return;
+	}
+	resume_check	= false;
+	if (mode == POWER_OFF) return;							// Nothing to save, the tip is cold
+	uint8_t slot	= 0;
+	for (uint8_t i = 0; i < tip_slots; ++i) {
+		if (tip_state[i].ms == 0 || tip_state[i].tip == tip_id) {
+			slot = i;
+			break;
+		}
+		if (tip_state[i].ms < tip_state[slot].ms)
+			slot = i;
+	}
+	TIP_STATE *s	= &tip_state[slot];
+	saveState(s->pid);
+	s->temp			= temp_curr;
+	s->temp_set		= temp_low?temp_low:temp_set;
+	s->tip			= tip_id;
+	s->ms			= HAL_GetTick() | 1;
+}
+
+/*
+ * The tip has been inserted, t is the first measured temperature. If the same tip was removed shortly and its temperature
+ * is close to the saved one, resume the PID from the saved state. Otherwise, the tip is another one (or has cooled down),
+ * restart the control from scratch
+ */
+void IRON::resume(int32_t t) {
+	resetShortTemp();										// The estimation was frozen while the tip was removed
+	guard.reset();
+	d_temp.reset();
+	uint32_t now = HAL_GetTick();
+	for (uint8_t i = 0; i < tip_slots; ++i) {
+		TIP_STATE *s = &tip_state[i];
+		if (s->ms == 0 || s->tip != tip_id) continue;
+		bool fresh	= (now - s->ms < resume_time) && (abs(t - s->temp) <= resume_temp);
+		s->ms		= 0;									// The state is used once
+		if (fresh) {
+			restoreState(s->pid, t);
+			h_temp.init(t);
+			resumed_set	= s->temp_set;
+			if (mode == POWER_OFF)
+				mode = POWER_COOLING;						// The tip is warm
+			return;
+		}
+	}
+	resetPID();
+	h_temp.reset();
+	h_power.reset();
+	d_power.reset();
+	resumed_set	= 0;
+}
+
+
+/*
+ * Keep the time constants of the averages and the PID behavior when the control loop rate changes.
+ * The PID coefficients are rescaled by PID::reqPower()
+ */
+void IRON::setRate(uint8_t shift) {
+	IRON_HW::setRate(shift);
+	h_power.rescale(ec << shift);
+	h_temp.rescale(ec << shift);
+	d_power.rescale(ec << shift);
+	d_temp.rescale(ec << shift);
+	PID::setRate(shift);
+}
+
+/*
+ * The feedforward model: the power required to keep the temperature is proportional to the internal temperature.
+ * The tip thermocouple measures the temperature difference between the tip and the handle, so the internal
+ * temperature is the temperature above ambient (see TIP_CFG::tempCelsius()) and the heat loss is proportional to it
+ */
+void IRON::setFeedForward(uint8_t k) {
+	ff_k = constrain(k, 0, ff_max);
+	ff_learn.reset();
+}
+
+uint8_t IRON::learnedFeedForward(void) {
+	if (ff_learn.updates() < 255) return 0;					// Not enough data in steady state
+	return constrain(ff_learn.read(), 1, ff_max);
+}
+
+/*
+ * The boost is the power step dP applied to the FOPDT tip model y = K*dP*(1 - exp(-(t-L)/T)). The temperature starts
+ * to rise after the heat lag L, so the lag is the time passed less the time the temperature gain takes at the measured rate.
+ * The rate s is the raw temperature slope in the second half h of the identification time, it decays by T:
+ *   t - L = T*ln(1 + y*(exp(h/T) - 1) / (s*h))
+ * T is the static gain over the power to rate gain: K is the learned feedforward, K/T is the gain of ALPHA_BETA.
+ * Without the feedforward T is infinite and t - L = y/s. The gain learned over the short window and the filtered rate
+ * are biased low by the lag itself, so the gain only checks the boost was not disturbed (the power budget cut, the load)
+ * and the curvature. The lag is identified once per boost, boost_ident_time after the step, and averaged with the previous value
+ */
+void IRON::identifyLag(int32_t t, int32_t applied) {
+	uint32_t now = HAL_GetTick();
+	if (boost_n++ == 0) {									// The boost power is applied after this period
+		boost_start	= now;
+		boost_t0	= t;
+		boost_r0	= tempRate();
+		boost_p0	= applied;
+		boost_psum	= 0;
+		boost_e1	= 0;
+		return;
+	}
+	if (boost_start == 0) return;							// The lag has been identified in this boost
+	boost_psum += applied;
+	int32_t elapsed = now - boost_start;
+	if (boost_e1 == 0 && elapsed >= boost_ident_time / 2) {	// The start of the rate measurement
+		boost_e1	= elapsed;
+		boost_t1	= t;
+	}
+	if (elapsed < boost_ident_time) return;
+	boost_start = 0;
+	if (!isGainLearned()) return;
+	int32_t dp		= boost_psum / (boost_n - 1) - boost_p0;	// The power step applied by the boost
+	int32_t expect	= (tempGain() * dp / 256 * 50) >> 8;		// The rate gained by the model, internal units per second
+	int32_t rate	= (t - boost_t1) * 1000 / (elapsed - boost_e1) - boost_r0;	// The rate gained
+	if (expect < boost_min_rate || abs(rate - expect) * 2 > expect) return;
+	double	h		= elapsed - boost_e1;						// ms
+	double	y		= t - boost_t0 - (double)boost_r0 * elapsed / 1000;
+	double	s		= (double)rate / 1000;						// Internal units per ms
+	double	rise	= y / s;									// The rise time, ms
+	if (ff_k) {
+		double T	= 20.0 * 65536 * (1 << ff_shift) / ((double)ff_k * tempGain());	// ms
+		rise		= T * log(1 + y * (exp(h / T) - 1) / (s * h));
+	}
+	int32_t lag		= lround((elapsed - rise) / 20);			// 20 ms periods
+	lag				= constrain(lag, 1, boost_lag_max);
+	boost_lag		= boost_lag?((boost_lag + lag + 1) >> 1):lag;
+}
 
 void IRON::lowPowerMode(uint16_t t) {
     if (mode == POWER_ON && t < temp_set) {
@@ -40,6 +40,15 @@ void MSTBY_IRON::init(void) {
 	RENC*	pEnc	= &pCore->encoder;
 
 	pIron->switchPower(false);
+	uint8_t ff = pIron->learnedFeedForward();				// Save the feedforward coefficient learned in working mode
+	if (ff && abs(ff - pCFG->tipFeedForward()) > 1)
+		pCFG->saveTipFeedForward(ff);
+	uint8_t lag = pIron->boostLag();						// Save the tip heat lag identified by the boost
+	if (lag && abs(lag - pCFG->tipBoostLag()) > 1)
+		pCFG->saveTipBoostLag(lag);
+	pIron->selectTip(pCFG->currentTipIndex());				// Restore the controller state of the inserted tip if it is saved
+	pIron->setFeedForward(pCFG->tipFeedForward());
+	pIron->setBoostLag(pCFG->tipBoostLag());
 	pD->mainInit();
 	bool		celsius 	= pCFG->isCelsius();
 	int16_t  	ambient		= pIron->ambientTemp();
@@ -62,6 +71,7 @@ void MSTBY_IRON::init(void) {
 		pEnc->reset(temp_setH, t_min, t_max, 1, 1, false);
 	}
 	no_handle		= false;								// By default the soldering IRON handle is connected
+	cool_shown		= false;
 	old_temp_set	= temp_setH;							// Save the rotary encoder position
 	update_screen	= 0;									// Force to redraw the screen
 	clear_used_ms 	= 0;
@@ -149,6 +159,14 @@ MODE* MSTBY_IRON::loop(void) {
 		uint16_t	gun_temp	= pCore->hotgun.alternateTemp();
 		if (gun_temp > 0)
 			gun_temp = pCFG->tempToHuman(gun_temp, ambient, DEV_GUN);
+		uint16_t	cool_time	= pCore->hotgun.timeToCold();
+		if (cool_time) {									// Show the Hot Air Gun time to cold instead of the tip name
+			pD->coolTime(cool_time);
+			cool_shown = true;
+		} else if (cool_shown) {
+			cool_shown = false;
+			pD->tip(pCFG->tipName());
+		}
 		if (pCore->scrsaver.scrSaver()) {
 			pD->scrSave(SCR_MODE_OFF, temp_h, gun_temp);
 		} else {
@@ -183,6 +201,7 @@ void MWORK_IRON::init(void) {
 		pEnc->reset(tempH, t_min, t_max, 1, 1, false);
 	}
 	pIron->setTemp(ps_temp);
+	pIron->PID::load(pCFG->pidScheduled(ps_temp));			// Load the PID coefficients for the preset temperature
 	pD->mainInit();
 	pD->msgON();
 	pD->tip(pCFG->tipName());
@@ -194,6 +213,7 @@ void MWORK_IRON::init(void) {
 	old_temp_set 		= tempH;							// Save current rotary encoder position
 	update_screen		= 0;
 	pIron->switchPower(true);
+	pickup_time			= pIron->isBoosting()?HAL_GetTick():0;
 }
 
 void MWORK_IRON::adjustPresetTemp(void) {
@@ -295,6 +315,7 @@ MODE* MWORK_IRON::loop(void) {
 		update_screen		= 0;							// Update display
 		uint16_t temp = pCFG->humanToTemp(temp_set_h, ambient); // Translate human readable temperature into internal value
 		pIron->setTemp(temp);
+		pIron->PID::load(pCFG->pidScheduled(temp));
 		pCFG->savePresetTempHuman(temp_set_h);				// Update the information in memory only, do not change the EEPROM
 		idle_pwr.reset();									// Initialize the history for power in idle state (software turn-off)
 		pCore->scrsaver.reset();
@@ -321,12 +342,18 @@ MODE* MWORK_IRON::loop(void) {
 		tilt_active = pIron->isIronTiltSwitch(pCFG->isReedType());	// True if iron was used
 
 
-	// Check the IRON reaches the preset temperature
-	if ((abs(temp_set - temp) < 6) && (td <= 500) && (ap > 0))  {
+	// Check the IRON reaches the preset temperature: the estimated temperature is close and does not change
+	int est_temp		= pIron->temp();
+	if ((abs(temp_set - est_temp) < 6) && (abs(pIron->tempRate()) <= ready_rate) && (ap > 0))  {
 	    if (!ready) {
 	    	ready = true;
 	    	ready_clear	= HAL_GetTick() + 2000;
-	    	pD->msgReady();
+	    	if (pickup_time) {								// Show the time to ready after the pickup
+	    		pD->msgReadyTime((HAL_GetTick() - pickup_time + 50) / 100);
+	    		pickup_time = 0;
+	    	} else {
+	    		pD->msgReady();
+	    	}
 	    	pCore->buzz.shortBeep();
 	    	if (!pCore->scrsaver.scrSaver())
 	    		pD->mainShow(temp_set_h, temp_h, ambient, p, pCFG->isCelsius(), pCFG->isTipCalibrated(), gun_temp, 0, tilt_active);
@@ -392,7 +419,11 @@ MODE* MLOW_POWER::loop(void) {
 	// Check all conditions to return to the main working mode
 	if (mode_spress) {										// Be paranoid
 		// Check if iron was used or Hot Air Gun activated
-		if (pIron->isIronTiltSwitch(pCFG->isReedType()) || pCore->hotgun.isGunReedOpen()) {
+		if (pIron->isIronTiltSwitch(pCFG->isReedType())) {
+			pIron->wakeBoost();								// The IRON was picked up, heat it up as fast as possible
+			return mode_spress;								// Return to main working mode
+		}
+		if (pCore->hotgun.isGunReedOpen()) {
 			return mode_spress;								// Return to main working mode
 		}
 		// Check if rotary encoder pressed or rotated
@@ -538,13 +569,13 @@ MODE* MSLCT::loop(void) {
     }
 
 	if (pIron->isIronConnected() || !isACsine()) {
-		// Prevent bouncing event, when the IRON connection restored back too quickly.
+		// The same tip inserted back quickly (hot swap), keep the tip and its state
 		if (tip_begin_select && (HAL_GetTick() - tip_begin_select) < 1000) {
-			return 0;
+			return mode_return;
 		}
 		uint8_t tip_index = tip_list[index].tip_index;
 		pCFG->changeTip(tip_index);
-		pIron->reset();										// Clear temperature history and switch iron mode to "power off"
+		pIron->selectTip(tip_index);						// Clear temperature history of the new tip or restore the state of the warm one
 		return mode_return;
 	}
 
@@ -645,6 +676,7 @@ void MMENU::init(void) {
 	keep_iron	= pCFG->isKeepIron();
 	reed		= pCFG->isReedType();
 	temp_step	= pCFG->isBigTempStep();
+	fast_iron	= pCFG->isFastIron();
 	scr_saver	= pCFG->getScrTo();
 	set_param	= 0;
 	if (!pCFG->isTipCalibrated())
@@ -665,24 +697,24 @@ MODE* MMENU::loop(void) {
 	if (mode_menu_item != item) {								// The encoder has been rotated
 		mode_menu_item = item;
 		switch (set_param) {									// Setup new value of the parameter in place
-			case 6:												// Setup auto off timeout
+			case 7:												// Setup auto off timeout
 				if (item) {
 					off_timeout	= item + 2;
 				} else {
 					off_timeout = 0;
 				}
 				break;
-			case 7:												// Setup low power (standby) temperature
+			case 8:												// Setup low power (standby) temperature
 				if (item >= min_standby_C) {
 					low_temp = item;
 				} else {
 					low_temp = 0;
 				}
 				break;
-			case 8:												// Setup low power (standby) timeout
+			case 9:												// Setup low power (standby) timeout
 				low_to	= item;
 				break;
-			case 9:												// Setup Screen saver timeout
+			case 10:											// Setup Screen saver timeout
 				if (item) {
 					scr_saver = item + 2;
 				} else {
@@ -700,7 +732,7 @@ MODE* MMENU::loop(void) {
 		if (button > 0) {										// The button was pressed, current menu item can be selected for modification
 			switch (item) {										// item is a menu item
 				case 0:											// Boost parameters
-					pCFG->setup(off_timeout, buzzer, celsius, keep_iron, reed, temp_step, low_temp, low_to, scr_saver);
+					pCFG->setup(off_timeout, buzzer, celsius, keep_iron, reed, temp_step, fast_iron, low_temp, low_to, scr_saver);
 					return mode_menu_boost;
 				case 1:											// units C/F
 					celsius	= !celsius;
@@ -717,7 +749,10 @@ MODE* MMENU::loop(void) {
 				case 5:											// Preset temperature step (1/5)
 					temp_step = !temp_step;
 					break;
-				case 6:											// auto off timeout
+				case 6:											// IRON control loop rate (50/100 Hz)
+					fast_iron = !fast_iron;
+					break;
+				case 7:											// auto off timeout
 					{
 					set_param = item;
 					uint8_t to = off_timeout;
@@ -725,7 +760,7 @@ MODE* MMENU::loop(void) {
 					pEnc->reset(to, 0, 28, 1, 1, false);
 					break;
 					}
-				case 7:											// Standby temperature
+				case 8:											// Standby temperature
 					{
 					set_param = item;
 					uint16_t max_standby_C = pCFG->referenceTemp(0);
@@ -733,11 +768,11 @@ MODE* MMENU::loop(void) {
 					pEnc->reset(low_temp, min_standby_C-1, max_standby_C, 1, 5, false);
 					break;
 					}
-				case 8:											// Standby timeout
+				case 9:											// Standby timeout
 					set_param = item;
 					pEnc->reset(low_to, 1, 255, 1, 1, false);
 					break;
-				case 9:											// Screen saver timeout
+				case 10:										// Screen saver timeout
 					{
 					set_param = item;
 					uint8_t to = scr_saver;
@@ -745,33 +780,38 @@ MODE* MMENU::loop(void) {
 					pEnc->reset(to, 0, 58, 1, 1, false);
 					break;
 					}
-				case 10:										// save
-					pCFG->setup(off_timeout, buzzer, celsius, keep_iron, reed, temp_step, low_temp, low_to, scr_saver);
+				case 11:										// save
+					pCFG->setup(off_timeout, buzzer, celsius, keep_iron, reed, temp_step, fast_iron, low_temp, low_to, scr_saver);
 					pCFG->saveConfig();
 					pCore->buzz.activate(buzzer);
 					pCore->scrsaver.init(pCFG->getScrTo());		// Reload screen saver timeout
+					ironFastMode(pCFG->isFastIron());			// Apply new IRON control loop rate
 					mode_menu_item = 0;
 					return mode_return;
-				case 12:										// calibrate IRON tip
-					mode_menu_item = 8;
+				case 13:										// calibrate IRON tip
+					mode_menu_item = 9;
 					return mode_calibrate_menu;
-				case 13:										// activate tips
+				case 14:										// activate tips
 					mode_menu_item = 0;							// We will not return from tip activation mode to this menu
 					return mode_activate_tips;
-				case 14:										// tune the IRON potentiometer
+				case 15:										// tune the IRON potentiometer
 					mode_menu_item = 0;							// We will not return from tune mode to this menu
 					mode_tune->ironMode(true);
 					return mode_tune;
-				case 15:										// Hot Air Gun menu
-					mode_menu_item = 11;						// We will return from next level menu here
+				case 16:										// Hot Air Gun menu
+					mode_menu_item = 12;						// We will return from next level menu here
 					return mode_gun_menu;
-				case 16:										// Initialize the configuration
+				case 17:										// Initialize the configuration
 					pCFG->initConfigArea();
+					powerBudget(0);
+					gunBurstMode(false);
+					pCore->hotgun.predictorModel(0, 1, 0);		// The model is cleared as well
+					pCore->hotgun.clearFanReference();
 					mode_menu_item = 0;							// We will not return from tune mode to this menu
 					return mode_return;
-				case 17:										// Tune PID
+				case 18:										// Tune PID
 					return mode_tune_pid;
-				case 18:										// About dialog
+				case 19:										// About dialog
 					mode_menu_item = 0;
 					return mode_about;
 				default:										// cancel
@@ -832,14 +872,17 @@ MODE* MMENU::loop(void) {
 		case 5:													// Preset temperature step (1/5)
 			sprintf(item_value, "%1d deg.", temp_step?5:1);
 			break;
-		case 6:													// auto off timeout
+		case 6:													// IRON control loop rate
+			sprintf(item_value, "%3d Hz", fast_iron?100:50);
+			break;
+		case 7:													// auto off timeout
 			if (off_timeout) {
 				sprintf(item_value, "%2d min", off_timeout);
 			} else {
 				sprintf(item_value, "OFF");
 			}
 			break;
-		case 7:													// Standby temperature
+		case 8:													// Standby temperature
 			if (low_temp) {
 				if (celsius) {
 					sprintf(item_value, "%3d C", low_temp);
@@ -850,7 +893,7 @@ MODE* MMENU::loop(void) {
 				sprintf(item_value, "OFF");
 			}
 			break;
-		case 8:													// Standby timeout (5 secs intervals)
+		case 9:													// Standby timeout (5 secs intervals)
 			if (low_temp) {
 				uint16_t to = (uint16_t)low_to * 5;				// Timeout in seconds
 				if (to < 60) {
@@ -864,7 +907,7 @@ MODE* MMENU::loop(void) {
 				sprintf(item_value, "OFF");
 			}
 			break;
-		case 9:
+		case 10:
 			if (scr_saver) {
 				sprintf(item_value, "%2d min", scr_saver);
 			} else {
@@ -1560,7 +1603,10 @@ void MTPID::init(void) {
 
 	pD->pidInit();
 	pD->pidSetLowerAxisLabel("Dp");
-	pEnc->reset(0, 0, 2, 1, 1, true);							// Select the coefficient to be modified
+	last_item	= use_iron?3:2;									// The IRON PID can be tuned in the temperature bands or for the tip
+	pEnc->reset(0, 0, last_item, 1, 1, true);					// Select the coefficient to be modified
+	band		= 0;
+	pCore->iron.PID::load(pCore->cfg.CFG_CORE::pidParams(true));// Start from the configuration record coefficients
 	pCore->iron.setTemp(1200);									// Use 'middle' temperature
 	pCore->hotgun.setTemp(1200);
 	pCore->hotgun.setFan(1500);
@@ -1615,7 +1661,7 @@ MODE* MTPID::loop(void) {
 		update_screen = HAL_GetTick() + 100;
 		if (button == 1) {									// Short button press: select another PID coefficient
 			modify = false;
-			pEnc->reset(data_index, 0, 2, 1, 1, true);
+			pEnc->reset(data_index, 0, last_item, 1, 1, true);
 			return this;									// Restart the procedure
 		} else if (button == 2) {							// Long button press: toggle the power
 			on = !on;
@@ -1646,7 +1692,21 @@ MODE* MTPID::loop(void) {
 			data_index  = index;
 		}
 
-		if (button == 1) {									// Short button press: select another PID coefficient
+		if (button == 1 && index == 3) {					// Short button press on the title: select the IRON temperature band or the tip
+			if (++band > tip_set) band = 0;
+			if (band == tip_set) {							// The tip coefficients or the global ones if not set up yet
+				pIron->PID::load(pCFG->pidParams(true));
+				pIron->setTemp(1200);
+			} else if (band) {								// Tune the PID at the band center temperature
+				pIron->PID::load(pCFG->pidBand(band-1));
+				pIron->setTemp(pCFG->calibration(band-1));
+			} else {
+				pIron->PID::load(pCFG->CFG_CORE::pidParams(true));
+				pIron->setTemp(1200);
+			}
+			update_screen = 0;
+			return this;
+		} else if (button == 1) {							// Short button press: select another PID coefficient
 			modify = true;
 			data_index  = index;
 			// Prepare to change the coefficient [index]
@@ -1656,8 +1716,17 @@ MODE* MTPID::loop(void) {
 			return this;									// Restart the procedure
 		} else if (button == 2) {							// Long button press: save the parameters and return to menu
 			PIDparam pp = pPID->dump();
-			pCFG->savePID(pp, use_iron);
-			pCore->buzz.shortBeep();
+			bool saved	= true;
+			if (!use_iron || band == 0)
+				pCFG->savePID(pp, use_iron);
+			else if (band == tip_set)						// The global coefficients clear the tip PID
+				saved = pCFG->saveTipPID(pp);
+			else
+				pCFG->savePIDband(band-1, pp);
+			if (saved)
+				pCore->buzz.shortBeep();
+			else
+				pCore->buzz.failedBeep();
 			return mode_lpress;
 		}
 
@@ -1665,11 +1734,137 @@ MODE* MTPID::loop(void) {
 		for (uint8_t i = 0; i < 3; ++i) {
 			pid_k[i] = 	pPID->changePID(i+1, -1);
 		}
-		pD->pidShowMenu(pid_k, data_index);
+		char title[12];
+		if (band == tip_set)
+			sprintf(title, "%s", pCFG->tipName());
+		else if (band)
+			sprintf(title, "PID %3dC", pCFG->referenceTemp(band-1));
+		else
+			sprintf(title, "Tune PID");
+		pD->pidShowMenu(pid_k, data_index, title);
 	}
 	return this;
 }
 
+//---------------------- The Hot Air Gun PID autotune mode (relay method) --------
+/*
+ * The Hot Air Gun is heated by PID to the 'middle' temperature. When the temperature is stable, the power required
+ * to keep it is measured and the asymmetric relay starts: the power switches between base + delta and base - delta/2
+ * on every crossing of the temperature limits. The FOPDT model of the gun is identified by the relay oscillations
+ * (see PIDTUNE::identify()) and shown on the screen, the new PID coefficients are calculated by AMIGO rule.
+ * HOTGUN::power() runs once per TIM1 period (100 AC half-waves), so the control period is calculated from the AC frequency
+ * and the power is applied after the AC relay is ready. The new coefficients are checked in the PID mode:
+ * long press saves them, short press restores old coefficients.
+ */
+void MAUTOPID::init(void) {
+	DSPL*	pD		= &pCore->dspl;
+	HOTGUN*	pHG		= &pCore->hotgun;
+
+	pCore->encoder.reset(0, 0, 1, 1, 1, false);
+	pD->pidInit();
+	pD->pidSetLowerAxisLabel("Dp");
+	pD->autoPidInfo("Heating");
+	pHG->PID::load(pCore->cfg.pidParams(false));
+	pHG->setTemp(tune_temp);
+	pHG->setFan(1500);
+	pHG->switchPower(true);
+	phase			= TUNE_HEAT;
+	check_ms		= HAL_GetTick() + 2000;					// Wait 2 seconds before checking Hot Air Gun
+	stable_ms		= 0;
+	phase_end		= HAL_GetTick() + heat_timeout;
+	old_loops		= 0;
+	update_screen	= 0;
+}
+
+MODE* MAUTOPID::loop(void) {
+	DSPL*	pD		= &pCore->dspl;
+	CFG*	pCFG	= &pCore->cfg;
+	HOTGUN*	pHG		= &pCore->hotgun;
+
+	uint8_t	button	= pCore->encoder.buttonStatus();
+
+	if (HAL_GetTick() >= check_ms && !pHG->isGunConnected())
+		return 0;
+
+	if (phase == TUNE_CHECK) {
+		if (button == 2) {									// Long button press: save new coefficients and the model
+			PIDparam pp = pHG->dump();
+			pCFG->savePID(pp, false);
+			pCFG->saveGunModel(model_K, model_T, model_L);
+			pHG->predictorModel(model_K, model_T, model_L);
+			pCore->buzz.shortBeep();
+			return mode_lpress;
+		} else if (button == 1) {							// Short button press: discard new coefficients
+			pHG->PID::load(pCFG->pidParams(false));
+			return mode_return;
+		}
+	} else if (button) {									// Cancel the tuning
+		pHG->PID::load(pCFG->pidParams(false));
+		return mode_return;
+	}
+
+	uint32_t now	= HAL_GetTick();
+	if (phase == TUNE_HEAT) {
+		int16_t diff = (int16_t)pHG->averageTemp() - (int16_t)tune_temp;
+		if (abs(diff) <= stable_diff) {
+			if (!stable_ms) stable_ms = now;
+		} else {
+			stable_ms = 0;
+		}
+		if (stable_ms && now - stable_ms >= stable_time) {	// Start the relay around the power to keep the temperature
+			uint16_t base	= pHG->avgPower();
+			delta_power		= base;
+			if (delta_power > pHG->getMaxPower() - base)
+				delta_power	= pHG->getMaxPower() - base;
+			if (delta_power < 2)
+				return failed();
+			pHG->autoTunePID(base, delta_power, tune_temp, tune_hyst, delta_power/2);
+			phase		= TUNE_RELAY;
+			phase_end	= now + relay_timeout;
+			pD->autoPidInfo("Relay");
+		} else if (now >= phase_end) {
+			return failed();
+		}
+	} else if (phase == TUNE_RELAY) {
+		uint16_t loops = pHG->autoTuneLoops();
+		if (loops != old_loops) {
+			old_loops = loops;
+			pD->autoPidCurrentLoop(loops, pHG->autoTunePeriod());
+		}
+		if (loops >= tune_loops) {
+			FOPDT model;
+			if (!pHG->identify(model))
+				return failed();
+			uint32_t T		= 1000;							// The TIM1 period, HOTGUN::power() call period (ms)
+			uint16_t freq	= pCore->mains.frequency();		// AC frequency, Hz * 10
+			if (freq) T = 500000 / freq;					// 100 half-waves
+			if (!pHG->modelPIDparams(model, T))
+				return failed();
+			model_K	= model.K;								// The dead time compensation works in TIM1 periods
+			model_T	= constrain((model.T + T/2) / T, 1, 1000);
+			model_L	= constrain((model.L + T/2) / T, 0, SMITH::max_delay);
+			pHG->switchPower(true);							// Keep the temperature with the new coefficients
+			phase = TUNE_CHECK;
+			pD->autoPidModel(model.K, model.T, model.L);
+			pCore->buzz.shortBeep();
+		} else if (now >= phase_end) {
+			return failed();
+		}
+	}
+
+	if (now < update_screen) return this;
+	update_screen = now + 1000;
+	pD->pidPutData((int16_t)pHG->averageTemp() - (int16_t)tune_temp, pHG->pwrDispersion());
+	pD->pidShowGraph(pHG->avgPowerPcnt());
+	return this;
+}
+
+MODE* MAUTOPID::failed(void) {
+	pCore->hotgun.PID::load(pCore->cfg.pidParams(false));
+	pCore->dspl.errorMessage("PID\nautotune\nfailed");
+	return 0;
+}
+
 //---------------------- The Hot Air Gun main working mode -----------------------
 void MWORK_GUN::init(void) {
 	DSPL*	pD		= &pCore->dspl;
@@ -1746,6 +1941,11 @@ MODE* MWORK_GUN::loop(void) {
     	return iron_standby;
     }
 
+    if (pHG->isFanFailed()) {								// The heater is not powered without airflow
+    	pD->errorMessage("Fan or\nnozzle\nfailed");
+    	return 0;
+    }
+
     // In the Screen saver mode, any rotary encoder change should be ignored
     if ((button || param != old_param) && scrSaver()) {
     	button = 0;
@@ -1831,15 +2031,16 @@ MODE* MWORK_GUN::loop(void) {
 }
 
 //---------------------- Hot Air Gun setup menu ----------------------------------
-MENU_GUN::MENU_GUN(HW* pCore, MODE* calib, MODE* pot_tune, MODE* pid_tune) : MODE(pCore) {
+MENU_GUN::MENU_GUN(HW* pCore, MODE* calib, MODE* pot_tune, MODE* pid_tune, MODE* auto_pid) : MODE(pCore) {
 	mode_calibrate	= calib;
 	mode_tune		= pot_tune;
 	mode_pid		= pid_tune;
+	mode_auto_pid	= auto_pid;
 }
 
 void MENU_GUN::init(void) {
-	pCore->encoder.reset(0, 0, 4, 1, 1, true);
-	old_item		= 5;
+	pCore->encoder.reset(0, 0, 9, 1, 1, true);
+	old_item		= 10;
 	update_screen	= 0;
 }
 
@@ -1885,7 +2086,47 @@ MODE* MENU_GUN::loop(void) {
 					return mode_pid;
 				}
 				break;
-			case 3:												// Initialize Hot Air Gun calibration data
+			case 3:												// Tune Hot Air Gun PID parameters automatically
+				if (mode_auto_pid) {
+					mode_auto_pid->ironMode(false);
+					return mode_auto_pid;
+				}
+				break;
+			case 4:												// Toggle the dead time compensation
+			{
+				bool use = !pCFG->isGunPredictor();
+				if (use && !pCore->hotgun.hasPredictorModel()) {	// Run the PID autotune first
+					pCore->buzz.failedBeep();
+					break;
+				}
+				pCFG->setGunPredictor(use);
+				pCFG->saveConfig();
+				pCore->hotgun.usePredictor(use);
+				break;
+			}
+			case 5:												// Switch the total power limit: OFF, min_budget, ... max_budget
+			{
+				uint16_t watts = pCFG->powerBudget() + 100;
+				if (watts < min_budget)
+					watts = min_budget;
+				else if (watts > max_budget)
+					watts = 0;
+				pCFG->savePowerBudget(watts);
+				powerBudget(watts);
+				break;
+			}
+			case 6:												// Toggle the burst fire mode
+			{
+				bool burst = !pCFG->isGunBurst();
+				pCFG->setGunBurst(burst);
+				pCFG->saveConfig();
+				gunBurstMode(burst);
+				break;
+			}
+			case 7:												// The nozzle is clear: learn the fan reference currents again
+				pCore->hotgun.clearFanReference();
+				break;
+			case 8:												// Initialize Hot Air Gun calibration data
 				pCFG->resetTipCalibration();
 				return mode_return;
 			default:											// exit
@@ -1893,7 +2134,28 @@ MODE* MENU_GUN::loop(void) {
 		}
 	}
 
-	pD->menuItemShow("Hot Gun", menu_list[item], 0, false);
+	const char *value = 0;
+	char budget[8];
+	if (item == 4) {
+		if (pCore->hotgun.hasPredictorModel())
+			value = pCFG->isGunPredictor()?"ON":"OFF";
+		else
+			value = "N/A";
+	} else if (item == 5) {
+		uint16_t watts = pCFG->powerBudget();
+		if (watts) {
+			sprintf(budget, "%4dW", watts);
+			value = budget;
+		} else {
+			value = "OFF";
+		}
+	} else if (item == 6) {
+		value = pCFG->isGunBurst()?"ON":"OFF";
+	} else if (item == 7) {
+		sprintf(budget, "%d/%d", pCore->hotgun.fanReferencePoints(), FAN_REF_POINTS);
+		value = budget;
+	}
+	pD->menuItemShow("Hot Gun", menu_list[item], value, false);
 	return this;
 }
 
@@ -1948,6 +2210,7 @@ MODE* MABOUT::loop(void) {
 //---------------------- The Debug mode: display internal parameters ------------
 void MDEBUG::init(void) {
 	gun_mode = false;
+	page	 = 0;
 	pCore->encoder.reset(0, 0, max_iron_power, 1, 5, false);
 	update_screen = 0;
 }
@@ -1981,13 +2244,44 @@ MODE* MDEBUG::loop(void) {
 		}
 	}
 
-	if (pCore->encoder.buttonStatus() == 2) {					// The button was pressed for a long time
+	uint8_t button = pCore->encoder.buttonStatus();
+	if (button == 1) {											// Short press: switch the debug page
+		if (++page >= pages) page = 0;
+		update_screen = 0;
+	} else if (button == 2) {									// The button was pressed for a long time
 	   	return mode_lpress;
 	}
 
 	if (HAL_GetTick() < update_screen) return this;
 	update_screen = HAL_GetTick() + 500;
 
+	if (page == page_prof) {
+		pD->debugProfile(isr_prof, PROF_NUM);
+		return this;
+	} else if (page == page_boot) {
+		static const char *names[2] = { "ready", "power" };
+		uint32_t values[2] = { bootReadyTime(), bootPowerTime() };
+		pD->debugValues("Boot, ms", names, values, 2);
+		return this;
+	} else if (page == page_adc) {
+		static const char *names[ADC_STAT_NUM] = { "miss", "late", "full", "err", "rarm", "cut", "skip" };
+		uint32_t values[ADC_STAT_NUM];
+		for (uint8_t i = 0; i < ADC_STAT_NUM; ++i)
+			values[i] = adcStatistics((t_adc_stat)i);
+		pD->debugValues("ADC", names, values, ADC_STAT_NUM);
+		return this;
+	} else if (page == page_power) {
+		static const char *names[PWR_STAT_NUM] = { "peak W", "peak dA", "iron cut", "gun cut" };
+		uint32_t values[PWR_STAT_NUM];
+		for (uint8_t i = 0; i < PWR_STAT_NUM; ++i)
+			values[i] = powerStatistics((t_pwr_stat)i);
+		pD->debugValues("Power", names, values, PWR_STAT_NUM);
+		return this;
+	} else if (page >= page_hist) {
+		pD->debugHistogram(page - page_hist, &isr_prof[page - page_hist]);
+		return this;
+	}
+
 	uint16_t data[4];
 	data[2]		= pIron->ambientInternal();
 	if (gun_mode) {
@@ -1999,7 +2293,7 @@ MODE* MDEBUG::loop(void) {
 		data[1] 	= pIron->ironCurrent();
 		data[3]		= pIron->tiltInternal();
 	}
-	pD->debugShow(gun_mode, pwr, pIron->isIronConnected(), pHG->isGunConnected(), data);
+	pD->debugShow(gun_mode, pwr, pIron->isIronConnected(), pHG->isGunConnected(), data, pCore->mains.frequency(), pCore->mains.isLocked());
 	return this;
 }
 
@@ -27,11 +27,10 @@ void PID::load(const PIDparam &p) {
 	Kd	= p.Kd;
 }
 
-void PID::init(uint8_t denominator_p) {							// PID parameters are initialized from EEPROM by  call
+void PID::init(void) {										// PID parameters are initialized from EEPROM by  call
 	Kp	= 10;
 	Ki	= 10;
 	Kd  = 0;
-	this->denominator_p = denominator_p;
 }
 
 void PID::resetPID(void) {
@@ -41,6 +40,40 @@ void PID::resetPID(void) {
 	i_summ 			= 0;
 }
 
+void PID::saveState(PID_STATE &s) {
+	s.power			= power;
+	s.ff_applied	= ff_applied;
+	s.rate_shift	= rate_shift;
+	s.valid			= (temp_h1 != 0);
+}
+
+/*
+ * The iterative power keeps the power required at the saved temperature, so the control resumes smoothly.
+ * The previous temperatures are set to the actual one to prevent the derivative kick
+ */
+void PID::restoreState(const PID_STATE &s, int16_t temp) {
+	if (!s.valid) {
+		resetPID();
+		return;
+	}
+	power		= s.power;
+	if (s.rate_shift > rate_shift)							// The power is stored in the scaled units
+		power >>= s.rate_shift - rate_shift;
+	else
+		power <<= rate_shift - s.rate_shift;
+	ff_applied	= s.ff_applied;
+	i_summ		= 0;
+	temp_h0		= temp;
+	temp_h1		= temp;
+}
+
+void PID::setRate(uint8_t shift) {
+	if (shift > max_rate_shift) shift = max_rate_shift;
+	if (shift == rate_shift) return;
+	rate_shift = shift;
+	resetPID();												// The power is stored in the scaled units
+}
+
 int32_t PID::changePID(uint8_t p, int32_t k) {
 	switch(p) {
     	case 1:
@@ -64,20 +97,20 @@ int32_t PID::changePID(uint8_t p, int32_t k) {
  * epsilon - hysteresis (delta_temp)
  *
  * Pu = period - the oscillation period, ms
+ * T  = the control loop period, ms: 50 for the IRON, the TIM1 period (about 1 second) for the Hot Air Gun
  * Kp = 0.6*Ku; Ti = 0.5*Pu; Td = 0.125*Pu;
  * Ki = Kp*T/Ti;
  * Kd = Kp*Td/T;
  */
-void PID::newPIDparams(uint16_t delta_power, uint32_t diff, uint32_t period) {
-	uint32_t T = 50;										// Check IRON period, ms
+void PID::newPIDparams(uint16_t delta_power, uint32_t diff, uint32_t period, uint32_t T) {
+	if (T == 0) T = 50;
 	double Ku  = 4 * delta_power;
 	Ku /= M_PI * sqrt(diff);
 	uint32_t denominator = 1 << denominator_p;
 	Kp = round(Ku * 0.6 * denominator);						// Translate Kp to the numerator of implemented PID
-	Ki = (Kp * T * 2 + period/2) / period;
-	Kd = (Kp * period) >> 3;								// 1/8
-	Kd += T/2;
-	Kd /= T;
+	Ki = ((int64_t)Kp * T * 2 + period/2) / period;
+	int64_t kd = ((int64_t)Kp * period) >> 3;				// 1/8, the Hot Air Gun oscillation period is long
+	Kd = (kd + T/2) / T;
 	/*
 	 *  The algorithm gives very big values for Kd (about 39 -> 39*2048=79892)
 	 *  The big values of Kd gives us the big power dispersion
@@ -86,42 +119,62 @@ void PID::newPIDparams(uint16_t delta_power, uint32_t diff, uint32_t period) {
 	Kd = constrain(Kd, 0, 10000);
 }
 
-int32_t PID::reqPower(int16_t temp_set, int16_t temp_curr) {
-	if (temp_h0 == 0) {										// Use direct formulae because do not know previous temperature
-		power 		= 0;
-		i_summ 		= 0;
-		i_summ += temp_set - temp_curr;
-		power = Kp*(temp_set - temp_curr) + Ki * i_summ;
-	} else {
-		int32_t kp = Kp * (temp_h1 	- temp_curr);
-		int32_t ki = Ki * (temp_set	- temp_curr);
-		int32_t kd = Kd * (temp_h0 	+ temp_curr - 2 * temp_h1);
-		int32_t delta_p = kp + ki + kd;
-		power += delta_p;									// Power is stored multiplied by denominator!
-	}
-	temp_h0 = temp_h1;
-	temp_h1 = temp_curr;
-	int32_t pwr = power + (1 << (denominator_p-1));			// prepare the power to divide by denominator, round the result
-	pwr >>= denominator_p;									// divide by the denominator
-	return pwr;
+/*
+ * AMIGO tuning rule (Astrom, Hagglund) for the FOPDT model:
+ * Kp = (0.2 + 0.45*T/L) / K; Ti = L * (0.4*L + 0.8*T) / (L + 0.1*T); Td = 0.5*L*T / (0.3*L + T)
+ * The coefficients are translated to the implemented PID as in newPIDparams(): Ki = Kp*Ts/Ti; Kd = Kp*Td/Ts,
+ * where Ts is the control loop period, ms. The sampling adds half the control period to the dead time.
+ * The coefficients are limited to the range saved in the configuration record
+ */
+bool PID::modelPIDparams(const FOPDT &model, uint32_t Ts) {
+	if (model.K == 0 || model.T == 0 || Ts == 0) return false;
+	double K	= model.K / 16.0;
+	double T	= model.T;
+	double L	= model.L + Ts / 2.0;
+	double kp	= (0.2 + 0.45 * T / L) / K;
+	double Ti	= L * (0.4 * L + 0.8 * T) / (L + 0.1 * T);
+	double Td	= 0.5 * L * T / (0.3 * L + T);
+	kp *= 1 << denominator_p;								// Translate Kp to the numerator of implemented PID
+	Kp	= constrain(round(kp), 1, 65535);
+	Ki	= constrain(round(kp * Ts / Ti), 0, 65535);
+	Kd	= constrain(round(kp * Td / Ts), 0, 65535);
+	return true;
 }
 
-void PIDTUNE::start(uint16_t base_pwr, uint16_t delta_power, uint16_t base_temp, uint16_t delta_temp) {
+void PIDTUNE::start(uint16_t base_pwr, uint16_t delta_power, uint16_t base_temp, uint16_t delta_temp, uint16_t delta_low) {
 	if (base_pwr && delta_power) {
+		if (delta_low == 0 || delta_low > base_pwr)
+			delta_low = delta_power;						// Symmetric relay
 		this->base_power	= base_pwr;						// The power required to keep the preset temperature
-		this->delta_power	= delta_power;					// Apply +- delta power in relay method
+		this->delta_power	= delta_power;					// Apply + delta power in relay method
+		this->delta_low		= delta_low;					// Apply - delta power in relay method
 		this->base_temp		= base_temp;
 		this->delta_temp	= delta_temp;
 		app_delta_power		= false;
 		pwr_change			= 0;
+		on_start			= 0;
+		last_run			= 0;
+		sum_temp			= 0;
+		sum_power			= 0;
+		power_dev			= 0;
+		all_temp			= 0;
+		all_power			= 0;
 		loops				= 0;
 		period.reset();
 		temp_min.reset();
 		temp_max.reset();
+		on_time.reset();
 	}
 }
 
 uint16_t PIDTUNE::run(uint32_t t) {
+	uint32_t now = HAL_GetTick();
+	if (last_run) {											// Integrate the deviations of the temperature and the applied power
+		uint32_t dt	= now - last_run;
+		sum_temp	+= ((int32_t)t - (int32_t)base_temp) * (int32_t)dt;
+		sum_power	+= power_dev * (int32_t)dt;
+	}
+	last_run = now;
 	if (app_delta_power) {									// Applying extra power
 		if (check_min && (int16_t)t > base_temp) {			// Finish looking for minimum temperature
 			check_min = false;
@@ -130,12 +183,19 @@ uint16_t PIDTUNE::run(uint32_t t) {
 		if ((int16_t)t > base_temp + delta_temp) {			// Crossed high temperature limit, decrease the power
 			app_delta_power = false;
 			if (pwr_change > 0) {
-				period.update(HAL_GetTick() - pwr_change);
-				pwr_change = HAL_GetTick();
+				period.update(now - pwr_change);
+				if (on_start) on_time.update(now - on_start);
+				all_temp	+= sum_temp;						// For the static gain, see identify()
+				all_power	+= sum_power;
+				last_dev	= (int16_t)t - base_temp;
+				pwr_change = now;
 				++loops;
 			} else {
-				pwr_change = HAL_GetTick();
+				first_dev	= (int16_t)t - base_temp;
+				pwr_change = now;
 			}
+			sum_temp	= 0;								// Start new cycle
+			sum_power	= 0;
 			check_min	= false;							// Be paranoid
 			check_max	= true;
 			t_max		= t;
@@ -147,6 +207,7 @@ uint16_t PIDTUNE::run(uint32_t t) {
 		}
 		if ((int16_t)t < base_temp - delta_temp) {			// Crossed low temperature limit, increase the power
 			app_delta_power = true;
+			on_start	= now;
 			check_max	= false;							// Be paranoid
 			check_min	= true;
 			t_min		= t;
@@ -154,7 +215,47 @@ uint16_t PIDTUNE::run(uint32_t t) {
 	}
 	if (check_max && t > t_max)	t_max = t;					// Update maximum temperature of this cycle
 	if (check_min && t < t_min) t_min = t;					// Update minimum temperature of this cycle
-	uint16_t p = base_power;
-	if (app_delta_power) p += delta_power; else	p -= delta_power;
-	return p;
+	power_dev = app_delta_power?delta_power:-(int16_t)delta_low;
+	return base_power + power_dev;
+}
+
+/*
+ * Identify the FOPDT model y = K*exp(-L*s)/(T*s + 1) by the asymmetric relay oscillations.
+ * In the deviations from the base point, the power switches between +d1 and -d2 when the temperature crosses -+e.
+ * Because of the dead time, the temperature keeps moving after the switch and overshoots the switching level:
+ *   y_max = K*d1 - (K*d1 - e)*exp(-L/T),	y_min = -K*d2 + (K*d2 - e)*exp(-L/T)
+ * The half-periods are the dead time plus the time to reach the opposite switching level:
+ *   t_on  = L + T*ln((K*d1 - y_min) / (K*d1 - e)),	t_off = L + T*ln((K*d2 + y_max) / (K*d2 - e))
+ * L/T is calculated by both overshoots and T by both half-periods. K is the ratio of the temperature and power
+ * deviation integrals (see run()) corrected by the heat stored between the first and the last cycle boundaries:
+ *   K*Int(dP) = Int(dy) + T*(y_last - y_first)
+ * The boundary temperature is sampled once per control period, so the correction is not small. It requires T,
+ * so K and T are refined together
+ */
+bool PIDTUNE::identify(FOPDT &model) {
+	if (loops < 2 || all_power == 0) return false;
+	double K		= (double)all_temp / all_power;
+	double d1		= delta_power;
+	double d2		= delta_low;
+	double e		= delta_temp;
+	double y_max	= (double)temp_max.read() - base_temp;
+	double y_min	= (double)temp_min.read() - base_temp;
+	double t_on		= on_time.read();
+	double t_off	= (double)period.read() - t_on;
+	if (t_on <= 0 || t_off <= 0 || y_max <= e || y_min >= -e) return false;
+	double r = 0, T = 0;
+	for (uint8_t i = 0; i < 4; ++i) {
+		if (K*d1 <= y_max || K*d2 <= -y_min) return false;
+		r				= (log((K*d1 - e) / (K*d1 - y_max)) + log((K*d2 - e) / (K*d2 + y_min))) / 2;	// L/T
+		double T_on		= t_on  / (r + log((K*d1 - y_min) / (K*d1 - e)));
+		double T_off	= t_off / (r + log((K*d2 + y_max) / (K*d2 - e)));
+		T				= (T_on + T_off) / 2;
+		if (T <= 0) return false;
+		K = (all_temp + T * (last_dev - first_dev)) / all_power;
+	}
+	if (K <= 0) return false;
+	model.K			= constrain(round(K * 16), 1, 65535);
+	model.T			= round(T);
+	model.L			= round(r * T);
+	return true;
 }
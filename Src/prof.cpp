@@ -0,0 +1,73 @@
+/*
+ * prof.cpp
+ *
+ */
+
+#include "prof.h"
+#ifndef USE_HAL_DRIVER
+#include <chrono>
+#endif
+
+ISR_PROF isr_prof[PROF_NUM];
+
+#ifdef USE_HAL_DRIVER
+void ISR_PROF::init(void) {
+	CoreDebug->DEMCR	|= CoreDebug_DEMCR_TRCENA_Msk;		// Enable trace to use DWT
+	DWT->CYCCNT			= 0;
+	DWT->CTRL			|= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+uint32_t ISR_PROF::cycles(void) {
+	return DWT->CYCCNT;
+}
+
+uint32_t ISR_PROF::toUs(uint32_t cycles) {
+	return cycles / (SystemCoreClock / 1000000);
+}
+#else
+void ISR_PROF::init(void) { }
+
+uint32_t ISR_PROF::cycles(void) {
+	return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t ISR_PROF::toUs(uint32_t cycles) {
+	return cycles / 1000;
+}
+#endif
+
+void ISR_PROF::reset(void) {
+	t_min	= 0xFFFFFFFF;
+	t_max	= 0;
+	t_summ	= 0;
+	n		= 0;
+	for (uint8_t i = 0; i < PROF_HIST_SZ; ++i)
+		histogram[i] = 0;
+}
+
+void ISR_PROF::update(uint32_t start) {
+	uint32_t t = cycles() - start;							// Unsigned arithmetic is correct when the counter wraps
+	if (t < t_min) t_min = t;
+	if (t > t_max) t_max = t;
+	// Keep the mean of the recent calls: halve the statistics after max_n calls or if the summary would overflow (long ISR)
+	while (n >= max_n || t_summ > 0xFFFFFFFF - t) {
+		t_summ >>= 1;
+		n >>= 1;
+	}
+	t_summ	+= t;
+	++n;
+	uint8_t i = 0;
+	while ((t >>= 1) && i < PROF_HIST_SZ-1) ++i;			// log2(t)
+	if (histogram[i] == 0xFFFF) {							// Halve all the bins to keep the histogram shape
+		for (uint8_t j = 0; j < PROF_HIST_SZ; ++j)
+			histogram[j] >>= 1;
+	}
+	++histogram[i];
+}
+
+uint16_t ISR_PROF::histMax(void) {
+	uint16_t h_max = 0;
+	for (uint8_t i = 0; i < PROF_HIST_SZ; ++i)
+		if (histogram[i] > h_max) h_max = histogram[i];
+	return h_max;
+}
@@ -15,6 +15,7 @@ int32_t EMP_AVERAGE::average(int32_t value) {
 void EMP_AVERAGE::update(int32_t value) {
 	uint8_t round_v = emp_k >> 1;
 	emp_data += value - (emp_data + round_v) / emp_k;
+	if (n_upd < 255) ++n_upd;
 }
 
 int32_t EMP_AVERAGE::read(void) {
@@ -22,6 +23,123 @@ int32_t EMP_AVERAGE::read(void) {
 	return (emp_data + round_v) / emp_k;
 }
 
+void ALPHA_BETA::update(int32_t value, int32_t power) {
+	if (n_upd == 0) {										// Start from the measured value
+		x			= value << 8;
+		v			= 0;
+		last_power	= power;
+		n_upd		= 1;
+		return;
+	}
+	int32_t dp	= power - last_power;						// The power applied since previous measurement
+	last_power	= power;
+	int32_t vp	= v + ((b * dp) >> 8);						// Predict the rate and the temperature
+	int32_t xp	= x + vp;
+	int32_t r	= constrain((value << 8) - xp, -max_error, max_error);
+	int32_t ev	= (beta * r) >> 12;							// The rate correction
+	x			= xp + ((alpha * r) >> 12);
+	v			= vp + ev;
+	if (learn_cnt) {										// Learn the power to rate coefficient
+		learn_ev	+= ev;
+		learn_var	+= abs(dp);
+		if (learn_var * 4 > abs(learn_dp))					// The power was not steady after the step
+			learn_cnt = 0;
+		else if (--learn_cnt == 0) {
+			b = constrain(b + (((learn_ev << 8) / learn_dp) >> lms_shift), 0, max_b);
+			if (n_learn < 255) ++n_learn;
+		}
+	}
+	if (!learn_cnt && abs(dp) >= min_learn_dp) {			// Start learning after the big power step
+		learn_dp	= dp;
+		learn_ev	= 0;
+		learn_var	= 0;
+		learn_cnt	= learn_window << shift;
+	}
+	if (n_upd < 255) ++n_upd;
+}
+
+void ALPHA_BETA::rescale(uint8_t shift) {
+	if (shift == this->shift) return;
+	if (shift > this->shift) {								// The rate per period and b decrease
+		v	>>= shift - this->shift;
+		b	>>= shift - this->shift;
+	} else {
+		v	<<= this->shift - shift;
+		b	<<= this->shift - shift;
+	}
+	this->shift	= shift;
+	learn_cnt	= 0;
+	alpha	= alpha_nom >> shift;
+	beta	= beta_nom  >> (2*shift);
+}
+
+void THERMAL_GUARD::reset(void) {
+	prev_t		= -1;
+	prev_raw	= -1;
+	rate		= 0;
+	pwr			= 0;
+	run_cnt		= 0;
+	no_heat_cnt	= 0;
+	jump_cnt	= 0;
+}
+
+/*
+ * Called every control period with the filtered temperature, the raw temperature, and the power applied
+ * during the period the temperature was measured. heating is true when the temperature is far below the preset one
+ */
+THERMAL_GUARD::t_fault THERMAL_GUARD::check(int32_t t, int32_t t_raw, int32_t power, bool heating) {
+	if (fault_type != TG_OK) return fault_type;
+	if (prev_t < 0) {										// The first period after reset
+		prev_t		= t;
+		prev_raw	= t_raw;
+		pwr			= power << 8;
+		return TG_OK;
+	}
+	bool jump	= abs(t_raw - prev_raw) > max_jump;			// Compare with the last trusted reading
+	if (jump || t_raw >= raw_saturated) {					// The sensor check
+		if (++jump_cnt >= sensor_cycles) fault_type = TG_SENSOR;
+	} else {
+		jump_cnt = 0;
+	}
+	if (!jump) prev_raw = t_raw;							// The single spike is ignored
+	rate		+= (((t - prev_t) << 8) - rate) >> rate_shift;
+	pwr			+= ((power << 8) - pwr) >> rate_shift;
+	prev_t		= t;
+
+	int32_t	p	= pwr >> 8;
+	bool learned = gain_upd >= gain_learned;
+	int32_t expected = 0;
+	bool	runaway	 = false;
+	if (learned) {
+		expected	= (gain * p) >> 8;
+		int32_t limit = (gain * max_power) >> 9;			// Half of the full power rate
+		if (limit < min_rate) limit = min_rate;
+		runaway		= (rate - expected > limit);
+	} else {												// The temperature rises without power
+		runaway		= (p < (max_power >> 6)) && (rate > min_rate);
+	}
+	if (runaway) {											// The runaway check
+		if (++run_cnt >= runaway_cycles) fault_type = TG_RUNAWAY;
+	} else {
+		run_cnt = 0;
+	}
+	if (learned && heating && p > max_power * 3 / 4 && rate < expected / 4) {	// The no heating check
+		if (++no_heat_cnt >= no_heat_cycles) fault_type = TG_NO_HEAT;
+	} else {
+		no_heat_cnt = 0;
+	}
+	// Learn the gain when heating up at high power
+	if (heating && run_cnt == 0 && no_heat_cnt == 0 && p > max_power / 4 && rate > 0) {
+		int32_t g = (rate << 8) / p;
+		if (gain_upd == 0)
+			gain = g;
+		else
+			gain += (g - gain) >> gain_shift;
+		if (gain_upd < 255) ++gain_upd;
+	}
+	return fault_type;
+}
+
 int32_t	HIST::read(void) {
 	int32_t sum = 0;
 	if (len == 0) return 0;
@@ -61,12 +179,15 @@ uint32_t HIST::dispersion(void) {
 	return sum;
 }
 
-void SWITCH::init(uint8_t h_len, uint16_t off, uint16_t on) {
+void SWITCH::init(uint8_t h_len, uint16_t off, uint16_t on, uint8_t fast, bool first) {
 	EMP_AVERAGE::length(h_len);
     if (on < off) on = off;
     on_val    	= on;
     off_val   	= off;
     mode		= false;
+    fast_len	= fast;
+    fast_cnt	= 0;
+    first_read	= first;
 }
 
 
@@ -82,7 +203,23 @@ void SWITCH::update(uint16_t value) {
 	uint16_t max_val = on_val  + (on_val  >> 1);
 	uint16_t min_val = off_val - (off_val >> 1);
 	value = constrain(value, min_val, max_val);
-	uint16_t avg = EMP_AVERAGE::average(value);
+	// Fast path: several successive values beyond the threshold change the status without waiting for the average
+	if (fast_len && ((mode && value < off_val) || (!mode && value > on_val))) {
+		if (++fast_cnt >= fast_len) {
+			fast_cnt	= 0;
+			EMP_AVERAGE::init(value);
+			sw_changed	= true;
+			mode		= !mode;
+			return;
+		}
+	} else {
+		fast_cnt = 0;
+	}
+	uint16_t avg = value;
+	if (first_read && updates() == 0)						// The first value after init, the switch status is known immediately
+		EMP_AVERAGE::init(value);
+	else
+		avg = EMP_AVERAGE::average(value);
 	if (mode) {
 		if (avg < off_val) {
 			sw_changed	= true;
@@ -0,0 +1,212 @@
+/*
+ * adc_dma_bench.cpp
+ *
+ *  The interrupt work of one temperature window (one per 20 ms TIM2 period) before and after the ADC DMA was
+ *  switched to the circular mode. Before, the TIM2 interrupt started both ADCs and the DMA by HAL and the DMA
+ *  transfer complete callback stopped them. After, the TIM2 interrupt sets SWSTART and the half/full transfer
+ *  callback processes the window. The HAL calls are replaced by the register sequences of STM32F1 HAL
+ *  (ADC_Enable() with the stabilization delay loop, ADC_ConversionStop_Disable(), HAL_DMA_Start_IT(), HAL_DMA_Abort())
+ *  on the simulated registers. Timed by ISR_PROF host backend: the absolute numbers are host time, the ratio
+ *  and the counts of the delay loop iterations and DMA interrupts are the same on the board
+ */
+
+#include "check.h"
+#include "oversample.h"
+#include "prof.h"
+#include "ring.h"
+#include "stat.h"
+
+typedef OVERSAMPLER<2, 4> ADC_WIN;								// ADC_CONV and ADC_LOOPS in core.cpp
+static const uint32_t	slot_gun_temp	= ADC1_SLOT(0);
+static const uint32_t	slot_ambient	= ADC1_SLOT(1);
+static const uint32_t	slot_iron_temp	= ADC2_SLOT(0) | ADC2_SLOT(1);
+static const uint32_t	core_mhz		= 72;					// SystemCoreClock / 1000000
+static const uint32_t	stab_delay_us	= 1;					// ADC_STAB_DELAY_US of STM32F1 HAL
+static const uint32_t	loop_cycles		= 4;					// At least ldr, subs, str, bne per delay loop iteration
+static const int		windows			= 200000;
+
+// The simulated registers and the HAL handle state, the bits as in STM32F1 reference manual
+typedef struct {
+	volatile uint32_t	SR, CR1, CR2, DR;
+	volatile uint32_t	state, lock;
+} t_adc;
+typedef struct {
+	volatile uint32_t	CCR, CNDTR, CPAR, CMAR;
+	volatile uint32_t	state, lock;
+} t_dma;
+
+static const uint32_t	ADON	= 1UL << 0;
+static const uint32_t	DMA_EN	= 1UL << 8;
+static const uint32_t	SWSTART	= 1UL << 22;
+static const uint32_t	EXTTRIG	= 1UL << 20;
+static const uint32_t	EOC		= 1UL << 1;
+static const uint32_t	CH_EN	= 1UL << 0;
+static const uint32_t	CH_IT	= 0xEUL;						// TCIE, HTIE, TEIE
+static volatile uint32_t	dma_ifcr;
+
+typedef struct s_temp_sample {
+	uint16_t	iron;
+	uint16_t	ambient;
+} t_temp_sample;
+
+static t_adc						adc1, adc2;
+static t_dma						dma1_ch1;
+static uint16_t						buff[2*ADC_WIN::size];
+static RING<t_temp_sample, 4>		temp_ring;
+static EMP_AVERAGE					gun_temp(10);
+static volatile uint32_t			sink;
+static uint32_t						delay_loops	= 0;		// The stabilization delay loop iterations
+static uint32_t						dma_irqs	= 0;		// The DMA interrupts
+
+// ADC_Enable(): the ADC is powered on and the stabilization time is waited by the CPU loop
+static void adcEnable(t_adc *adc) {
+	if (adc->CR2 & ADON) return;
+	adc->CR2 |= ADON;
+	volatile uint32_t wait_loop_index = stab_delay_us * core_mhz;
+	delay_loops += wait_loop_index;
+	while (wait_loop_index != 0)
+		--wait_loop_index;
+	uint32_t tickstart = HAL_GetTick();
+	while (!(adc->CR2 & ADON)) {
+		if (HAL_GetTick() - tickstart > 2) return;
+	}
+}
+
+// ADC_ConversionStop_Disable()
+static void adcDisable(t_adc *adc) {
+	if (!(adc->CR2 & ADON)) return;
+	adc->CR2 &= ~ADON;
+	uint32_t tickstart = HAL_GetTick();
+	while (adc->CR2 & ADON) {
+		if (HAL_GetTick() - tickstart > 2) return;
+	}
+}
+
+// HAL_ADC_Start() of the slave ADC: enable only, the conversion is started by the master
+static void halAdcStart(t_adc *adc) {
+	if (adc->lock) return;
+	adc->lock	= 1;
+	adcEnable(adc);
+	adc->state	= (adc->state & ~0x1UL) | 0x100UL;
+	adc->lock	= 0;
+}
+
+// HAL_ADCEx_MultiModeStart_DMA(): enable the master ADC, start the DMA and the conversion
+static void halMultiModeStartDMA(t_adc *adc, t_dma *dma, uint16_t *data, uint32_t len) {
+	if (adc->lock) return;
+	adc->lock	= 1;
+	adcEnable(adc);
+	adc->state	= (adc->state & ~0x1UL) | 0x100UL;
+	adc->lock	= 0;
+	adc->SR		&= ~EOC;
+	adc->CR2	|= DMA_EN;
+	if (dma->lock) return;										// HAL_DMA_Start_IT()
+	dma->lock	= 1;
+	dma->state	= 2;
+	dma->CCR	&= ~CH_EN;
+	dma_ifcr	= 0xFUL;
+	dma->CNDTR	= len;
+	dma->CPAR	= (uint32_t)(uintptr_t)&adc->DR;
+	dma->CMAR	= (uint32_t)(uintptr_t)data;
+	dma->CCR	|= CH_IT;
+	dma->CCR	|= CH_EN;
+	adc->CR2	|= SWSTART | EXTTRIG;
+}
+
+// HAL_ADCEx_MultiModeStop_DMA(): disable the master ADC and abort the DMA
+static void halMultiModeStopDMA(t_adc *adc, t_dma *dma) {
+	if (adc->lock) return;
+	adc->lock	= 1;
+	adcDisable(adc);
+	adc->CR2	&= ~DMA_EN;
+	dma->CCR	&= ~CH_IT;										// HAL_DMA_Abort()
+	dma->CCR	&= ~CH_EN;
+	dma_ifcr	= 0xFUL;
+	dma->state	= 1;
+	dma->lock	= 0;
+	adc->state	= (adc->state & ~0x100UL) | 0x1UL;
+	adc->lock	= 0;
+}
+
+// HAL_ADC_Stop() of the slave ADC
+static void halAdcStop(t_adc *adc) {
+	if (adc->lock) return;
+	adc->lock	= 1;
+	adcDisable(adc);
+	adc->state	= (adc->state & ~0x100UL) | 0x1UL;
+	adc->lock	= 0;
+}
+
+// The window processing: the same code in both paths, see adcProcess() in core.cpp
+static void process(uint16_t *data) {
+	gun_temp.update(ADC_WIN::average<slot_gun_temp>(data));
+	t_temp_sample sample;
+	sample.iron		= ADC_WIN::average<slot_iron_temp>(data);
+	sample.ambient	= ADC_WIN::average<slot_ambient>(data);
+	temp_ring.push(sample);
+	temp_ring.pop(sample);										// Done by the control task, not timed
+	sink			= sample.iron;
+}
+
+// Before: the TIM2 interrupt starts the window, the DMA transfer complete callback stops and processes it
+static void windowBefore(ISR_PROF &prof) {
+	uint32_t start = ISR_PROF::cycles();
+	halAdcStart(&adc2);
+	halMultiModeStartDMA(&adc1, &dma1_ch1, buff, ADC_WIN::size/2);
+	prof.update(start);
+	start = ISR_PROF::cycles();									// DMA half transfer: HAL calls the empty weak callback
+	++dma_irqs;
+	prof.update(start);
+	start = ISR_PROF::cycles();									// DMA transfer complete
+	++dma_irqs;
+	halMultiModeStopDMA(&adc1, &dma1_ch1);
+	halAdcStop(&adc2);
+	process(buff);
+	prof.update(start);
+}
+
+// After: the TIM2 interrupt sets SWSTART, the half (or full) transfer callback processes the buffer half
+static void windowAfter(ISR_PROF &prof, uint8_t half) {
+	uint32_t start = ISR_PROF::cycles();
+	adc1.CR2 |= SWSTART;
+	prof.update(start);
+	start = ISR_PROF::cycles();
+	++dma_irqs;
+	process(&buff[half*ADC_WIN::size]);
+	prof.update(start);
+}
+
+int main(void) {
+	ISR_PROF before, after;
+	for (uint16_t i = 0; i < 2*ADC_WIN::size; ++i)
+		buff[i] = 1500 + (i & 7);
+
+	for (int w = 0; w < windows; ++w) {
+		buff[w & 15] = 1500 + (w & 7);							// Change the window to prevent the caching of the results
+		windowBefore(before);
+	}
+	uint32_t loops_before	= delay_loops / windows;
+	uint32_t irqs_before	= dma_irqs / windows;
+	delay_loops	= 0;
+	dma_irqs	= 0;
+	adc1.CR2 = adc2.CR2 = ADON | DMA_EN;						// Armed once by adcArm()
+	for (int w = 0; w < windows; ++w) {
+		buff[w & 15] = 1500 + (w & 7);
+		windowAfter(after, w & 1);
+	}
+	uint32_t loops_after	= delay_loops / windows;
+	uint32_t irqs_after		= dma_irqs / windows;
+
+	// Three (before) or two (after) interrupt calls per window are timed, the sum is the work per 20 ms
+	double ns_before	= 3.0 * before.meanTime();
+	double ns_after		= 2.0 * after.meanTime();
+	printf("ADC window interrupt work per 20 ms, host ns: before %.0f, after %.0f (%.0f%%)\n",
+		ns_before, ns_after, 100.0*ns_after/ns_before);
+	printf("DMA interrupts per 20 ms: before %u, after %u\n", (unsigned)irqs_before, (unsigned)irqs_after);
+	printf("ADC stabilization loop per 20 ms: before %u iterations (>= %u us at %u MHz), after %u\n",
+		(unsigned)loops_before, (unsigned)(loops_before * loop_cycles / core_mhz), (unsigned)core_mhz, (unsigned)loops_after);
+	CHECK(ns_after < ns_before);
+	CHECK(irqs_after < irqs_before);
+	CHECK(loops_before == 2 * stab_delay_us * core_mhz && loops_after == 0);
+	return checkResult();
+}
@@ -0,0 +1,85 @@
+/*
+ * alpha_beta_sim.cpp
+ *
+ *  The IRON temperature estimation on the simulated T12 tip with the thermocouple noise: the alpha-beta filter
+ *  with the power input (see ALPHA_BETA) against the former short exponential average EMP(8) and the long
+ *  average of it EMP(20), used by the 'Ready' check before. The power steps around the steady power teach the filter
+ *  the power to rate coefficient. Then the tip is heated at the constant power (the ramp) and the power is dropped
+ *  to keep the reached temperature (the steady state)
+ */
+
+#include <random>
+#include "check.h"
+#include "plant.h"
+#include "stat.h"
+
+static const double		noise_sd	= 2.0;					// The thermocouple noise (internal units rms)
+static const uint16_t	ramp_power	= 1000;					// Of max_iron_pwm 1960
+static const uint16_t	ramp_len	= 60;					// 1.2 seconds at 50 Hz
+static const uint16_t	steady_len	= 500;
+
+typedef struct {
+	double		lag;										// The average estimation error on the ramp
+	double		sd;											// The estimation noise in the steady state
+} t_result;
+
+static void stats(const double *err, uint16_t n, double &mean, double &sd) {
+	mean = 0;
+	for (uint16_t i = 0; i < n; ++i) mean += err[i];
+	mean /= n;
+	sd = 0;
+	for (uint16_t i = 0; i < n; ++i) sd += (err[i] - mean) * (err[i] - mean);
+	sd = sqrt(sd / n);
+}
+
+int main(void) {
+	PLANT tip = t12Plant();
+	tip.reset(1500);
+	std::mt19937 gen(1);
+	std::normal_distribution<double> noise(0.0, noise_sd);
+	ALPHA_BETA	ab;
+	EMP_AVERAGE	emp(8), chain(20);
+	double ramp[3][ramp_len], steady[3][steady_len];
+	uint16_t steady_power = lround(1500 * 1960 / 15000.0);	// Keeps the start temperature
+	int32_t power = steady_power;
+	for (uint16_t n = 0; n < 400; ++n) {					// Keep the temperature by the power steps: b is learned
+		power = steady_power + (((n / 100) & 1)?200:-200);
+		int32_t t = lround(tip.read() + noise(gen));
+		ab.update(t, power);
+		chain.update(emp.average(t));
+		tip.step(power / 1960.0);
+	}
+	for (uint16_t n = 0; n < ramp_len + steady_len; ++n) {
+		if (n == 0)			power = ramp_power;
+		if (n == ramp_len)	power = lround(tip.read() * 1960 / 15000.0);	// Keep the reached temperature
+		double real	= tip.read();
+		int32_t t	= lround(real + noise(gen));
+		ab.update(t, power);
+		int32_t e	= emp.average(t);
+		int32_t c	= chain.average(e);
+		double err[3] = {real - ab.read(), real - e, real - c};
+		for (uint8_t i = 0; i < 3; ++i) {
+			if (n < ramp_len)
+				ramp[i][n] = err[i];
+			else
+				steady[i][n - ramp_len] = err[i];
+		}
+		tip.step(power / 1960.0);
+	}
+	const char *name[3] = {"alpha-beta", "EMP(8)", "EMP(8)+EMP(20)"};
+	t_result r[3];
+	printf("estimation        ramp lag  steady sd\n");
+	for (uint8_t i = 0; i < 3; ++i) {
+		double mean;
+		stats(ramp[i], ramp_len, r[i].lag, mean);
+		stats(&steady[i][steady_len/2], steady_len/2, mean, r[i].sd);	// After the transient
+		printf("%-16s %9.1f %10.2f\n", name[i], r[i].lag, r[i].sd);
+	}
+
+	// The alpha-beta filter follows the ramp much closer without the extra noise
+	CHECK(fabs(r[0].lag) < r[1].lag / 3);
+	CHECK(r[1].lag < r[2].lag);
+	CHECK(r[0].sd < r[1].sd * 1.3);
+	CHECK(r[0].sd < noise_sd);
+	return checkResult();
+}
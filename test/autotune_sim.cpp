@@ -0,0 +1,115 @@
+/*
+ * autotune_sim.cpp
+ *
+ *  The Hot Air Gun PID autotune (see MAUTOPID) on the simulated heaters with the known FOPDT model:
+ *  the asymmetric relay oscillations, the model identification by PIDTUNE::identify() and the AMIGO tuning rule.
+ *  The heat-up with the AMIGO coefficients is compared with the relay (Ziegler-Nichols) coefficients, see newPIDparams()
+ */
+
+#include <random>
+#include "check.h"
+#include "plant.h"
+#include "gun.h"
+#include "tools.h"
+
+static const uint32_t	tim1_ms		= 1000;					// The TIM1 period, HOTGUN::power() call period
+static const uint16_t	tune_temp	= 1200;					// The same as in MAUTOPID
+static const uint8_t	tune_hyst	= 4;
+static const uint8_t	tune_loops	= 8;
+static const uint16_t	max_power	= 99;
+
+typedef struct {
+	double		K;											// The steady temperature at full power
+	double		T;											// The time constant, TIM1 periods
+	uint16_t	L;											// The dead time, TIM1 periods
+} t_plant;
+
+typedef struct {
+	double		overshoot;
+	double		iae;										// The integral of the absolute error, units * seconds
+} t_result;
+
+// The temperature with the thermocouple noise, the power is applied during the next TIM1 period
+class RIG {
+	public:
+		RIG(const t_plant &p) : heater(p.K, p.T, p.L), gen(1), noise(0.0, 1.0)	{ }
+		void		reset(double t)							{ heater.reset(t); }
+		int32_t		read(void)								{ return lround(heater.read() + noise(gen)); }
+		void		step(uint16_t p) {
+			heater.step(p / 100.0);
+			HAL_SetTick(HAL_GetTick() + tim1_ms);
+		}
+		double		temp(void)								{ return heater.read(); }
+	private:
+		PLANT		heater;
+		std::mt19937 gen;
+		std::normal_distribution<double> noise;
+};
+
+static bool relay(const t_plant &p, PIDTUNE &tune, uint16_t &delta) {
+	RIG rig(p);
+	rig.reset(tune_temp);
+	HAL_SetTick(1);
+	uint16_t base	= lround(tune_temp * 100.0 / p.K);		// The power to keep the temperature
+	delta			= std::min(base, (uint16_t)(max_power - base));
+	tune.start(base, delta, tune_temp, tune_hyst, delta/2);
+	for (uint32_t n = 0; n < 3000 && tune.autoTuneLoops() < tune_loops; ++n)
+		rig.step(tune.run(rig.read()));
+	return tune.autoTuneLoops() >= tune_loops;
+}
+
+static t_result heatUp(const t_plant &p, GUN_PID &pid) {
+	RIG rig(p);
+	rig.reset(0);
+	pid.resetPID();
+	t_result r = {0, 0};
+	for (uint32_t n = 0; n < 600; ++n) {					// 10 minutes
+		int32_t p = constrain(pid.reqPower(tune_temp, rig.read()), 0, max_power);
+		rig.step(p);
+		r.overshoot	 = std::max(r.overshoot, rig.temp() - tune_temp);
+		r.iae		+= fabs(rig.temp() - tune_temp) * tim1_ms / 1000.0;
+	}
+	return r;
+}
+
+int main(void) {
+	const t_plant plant[3] = {
+		{3000,  60, 3},										// The typical 858D heater
+		{2000,  30, 6},										// The long dead time
+		{4000, 120, 2},										// The slow heater
+	};
+	printf("  plant K,T,L       identified K,T,L    AMIGO overshoot, IAE    relay overshoot, IAE\n");
+	for (uint8_t i = 0; i < 3; ++i) {
+		const t_plant &p = plant[i];
+		PIDTUNE *tune = new PIDTUNE;
+		uint16_t delta = 0;
+		FOPDT model;
+		bool identified = relay(p, *tune, delta) && tune->identify(model);
+		CHECK(identified);
+		if (!identified) {
+			delete tune;
+			continue;
+		}
+		double K = model.K / 16.0, T = model.T / 1000.0, L = model.L / 1000.0;
+		double K_true = p.K / 100.0;
+
+		GUN_PID amigo, zn;
+		CHECK(amigo.modelPIDparams(model, tim1_ms));
+		double alpha = (tune->tempMax() - tune->tempMin()) / 2.0;
+		zn.newPIDparams(delta, lround(alpha*alpha - tune_hyst*tune_hyst), tune->autoTunePeriod(), tim1_ms);
+		delete tune;
+		t_result ra = heatUp(p, amigo);
+		t_result rz = heatUp(p, zn);
+		printf("%5.1f %4.0f %2d s   %6.1f %5.1f %4.1f s   %8.1f %10.0f   %8.1f %10.0f\n", K_true, p.T, p.L, K, T, L,
+				ra.overshoot, ra.iae, rz.overshoot, rz.iae);
+
+		// The relay identifies the plant. The dead time is measured with the sampling delay (half the period)
+		CHECK(fabs(K - K_true) < K_true * 0.1);
+		CHECK(fabs(T - p.T) < p.T * 0.25);
+		CHECK(fabs(L - p.L) <= 1.5);
+		// AMIGO heats up without the big overshoot and not slower than the relay rule
+		CHECK(ra.overshoot < tune_temp * 0.05);
+		CHECK(ra.iae < rz.iae * 1.1);
+	}
+	return checkResult();
+}
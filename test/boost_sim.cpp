@@ -0,0 +1,89 @@
+/*
+ * boost_sim.cpp
+ *
+ *  The IRON boost after the pickup from the low power mode on the simulated tips. The time to be ready (within 1% of
+ *  the preset temperature for good) and the overshoot are compared: no boost, the first boost (the heat lag is
+ *  identified 2 s after the boost start, the default lead is used before) and the boost with the heat lag averaged
+ *  by the previous boosts
+ */
+
+#include <random>
+#include "check.h"
+#include "plant.h"
+#include "iron.h"
+#include "tools.h"
+
+static const uint16_t	max_iron_pwm	= 1960;				// See core.cpp
+static const uint16_t	t_set			= 3000;
+static const uint16_t	t_low			= 1500;				// The low power mode temperature
+
+typedef struct {
+	double		ready;										// The time to stay within 1% of the preset temperature, seconds
+	double		over;										// The overshoot, internal units
+} t_result;
+
+class SIM {
+	public:
+		SIM(PLANT plant) : tip(plant), gen(1), noise(0.0, 2.0) {
+			HAL_SetTick(1);
+			TIM2->CCR1 = 0;
+			iron.init();
+			iron.load(PIDparam(2300, 50, 735));				// The default IRON PID coefficients, see config.cpp
+			iron.setFeedForward(17);						// The plants need 3000 / 15000 * 2000 * 128 / 3000
+			iron.setTemp(t_set);
+			iron.switchPower(true);
+			run(30);
+		}
+		// The IRON was in low power mode, then picked up
+		t_result	pickup(bool boost) {
+			iron.lowPowerMode(t_low);
+			run(40);
+			if (boost) iron.wakeBoost();
+			iron.switchPower(true);
+			return run(20);
+		}
+		IRON		iron;
+	private:
+		t_result	run(double seconds) {
+			uint32_t periods = seconds * 50, last_out = 0;
+			double over = 0;
+			for (uint32_t n = 0; n < periods; ++n) {
+				int32_t t = lround(tip.read() + noise(gen));
+				uint16_t p = constrain(iron.power(constrain(t, 0, 4095)), 0, max_iron_pwm);
+				TIM2->CCR1 = p;								// The power applied, see controlTask()
+				tip.step(p / 2000.0);
+				HAL_SetTick(HAL_GetTick() + 20);
+				if (fabs(tip.read() - t_set) > t_set * 0.01) last_out = n + 1;
+				over = std::max(over, tip.read() - t_set);
+			}
+			t_result r = {last_out * 0.02, over};
+			return r;
+		}
+		PLANT		tip;
+		std::mt19937 gen;
+		std::normal_distribution<double> noise;
+};
+
+int main(void) {
+	const char*	name[2]	= {"T12 tip, lag 40 ms", "heavy tip, lag 200 ms"};
+	PLANT		plant[2] = {t12Plant(), PLANT(15000.0, 2500.0, 10)};
+	uint16_t	lag[2]	= {2, 10};							// The plant dead time, 20 ms periods
+	printf("%-22s %-18s %-18s %-18s %s\n", "", "no boost", "first boost", "boost, learned", "lag");
+	for (uint8_t i = 0; i < 2; ++i) {
+		SIM *s = new SIM(plant[i]);
+		t_result none	= s->pickup(false);
+		t_result first	= s->pickup(true);
+		for (uint8_t k = 0; k < 4; ++k)						// Let the lag to be averaged by several boosts
+			s->pickup(true);
+		t_result learned = s->pickup(true);
+		uint8_t l = s->iron.boostLag();
+		printf("%-22s %6.2f s %6.1f    %6.2f s %6.1f    %6.2f s %6.1f    %3d ms\n", name[i],
+			none.ready, none.over, first.ready, first.over, learned.ready, learned.over, l * 20);
+		CHECK(abs(l - lag[i]) <= 3);
+		CHECK(learned.ready < none.ready * 0.7);
+		CHECK(learned.over <= t_set * 0.01);
+		CHECK(learned.ready <= first.ready + 0.1 || learned.over < first.over);
+		delete s;
+	}
+	return checkResult();
+}
@@ -0,0 +1,109 @@
+/*
+ * budget_test.cpp
+ *
+ *  The power budget arbiter of the IRON and the Hot Air Gun. One TIM1 period (100 mains half-waves) has 50 TIM2
+ *  periods; the Hot Air Gun triac is on in the first granted half-waves, the IRON is asked every TIM2 period like
+ *  controlTask() does. Checked: the device without priority keeps min_share of its request, the IRON postponed power
+ *  is paid back and limited by max_debt, the peak and the average power do not exceed the budget
+ */
+
+#include "check.h"
+#include "budget.h"
+
+static const uint16_t	max_gun_pwm		= 99;					// The same as in core.cpp
+static const uint16_t	max_iron_pwm	= 1960;
+static const uint8_t	tim2_periods	= 50;					// TIM2 periods in TIM1 period
+static const uint8_t	min_share		= 25;					// The same as PWR_BUDGET::min_share
+static const uint32_t	max_debt		= 2000*25;				// The same as PWR_BUDGET::max_debt
+
+typedef struct s_period {
+	uint16_t	gun;											// Half-waves granted to the Hot Air Gun
+	uint32_t	iron;											// TIM2 ticks granted to the IRON
+	uint32_t	iron_req;										// TIM2 ticks requested by the IRON
+	uint32_t	watts;											// The average power of both heaters
+} t_period;
+
+// The Hot Air Gun triac is on in the next TIM2 period, see gunFiring() in core.cpp
+static bool gunFiring(uint16_t cnt, uint16_t on) {
+	if (on == 0) return false;
+	return (cnt < on) || (cnt + 2 > max_gun_pwm);
+}
+
+static t_period period(PWR_BUDGET &b, uint16_t gun_req, uint16_t iron_req) {
+	t_period p = {0, 0, 0, 0};
+	p.gun = b.gun(gun_req);
+	for (uint8_t k = 0; k < tim2_periods; ++k) {
+		p.iron		+= b.iron(iron_req, max_iron_pwm, gunFiring(2*k, p.gun));
+		p.iron_req	+= iron_req;
+	}
+	p.watts = (700 * p.gun + 50) / 100 + (72 * p.iron + 50000) / 100000;
+	return p;
+}
+
+// Run several TIM1 periods to reach the steady state, the average power is checked, return the last period
+static t_period steady(PWR_BUDGET &b, uint16_t budget, uint16_t gun_req, uint16_t iron_req) {
+	t_period p = {0, 0, 0, 0};
+	for (uint8_t i = 0; i < 64; ++i) {							// The IRON debt up to max_debt is paid back in about a minute
+		p = period(b, gun_req, iron_req);
+		CHECK(p.watts <= budget);
+	}
+	return p;
+}
+
+int main(void) {
+	PWR_BUDGET b;
+
+	// The Hot Air Gun has priority, the IRON requests 50%: the IRON keeps min_share of the request
+	b.init(700);
+	b.priority(true);
+	t_period p = steady(b, 700, max_gun_pwm, 1000);
+	printf("gun first, iron 50%%: gun %u half-waves, iron %u of %u ticks, %u W\n",
+		(unsigned)p.gun, (unsigned)p.iron, (unsigned)p.iron_req, (unsigned)p.watts);
+	CHECK(p.iron * 100 >= p.iron_req * min_share);
+	CHECK(p.gun > 50);
+
+	// The Hot Air Gun is on longer than max_debt allows, then stops: the postponed IRON power is paid back
+	for (uint8_t k = 0; k < 2*tim2_periods; ++k)
+		CHECK(b.iron(1000, max_iron_pwm, true) == 0);
+	uint32_t extra = 0;
+	uint8_t	 paid_in = 0;
+	for (uint8_t k = 0; k < 2*tim2_periods; ++k) {
+		uint16_t g = b.iron(1000, max_iron_pwm, false);
+		CHECK(g <= max_iron_pwm);
+		extra += g - 1000;
+		if (g > 1000) paid_in = k + 1;
+	}
+	printf("gun first, payback: %u ticks in %u periods\n", (unsigned)extra, (unsigned)paid_in);
+	CHECK(extra == max_debt);
+	CHECK(paid_in == (max_debt + max_iron_pwm - 1000 - 1) / (max_iron_pwm - 1000));
+	// The IRON does not require the power: the debt is forgotten
+	steady(b, 700, max_gun_pwm, 1000);
+	b.iron(0, max_iron_pwm, false);
+	CHECK(b.iron(1000, max_iron_pwm, false) == 1000);
+
+	// The IRON has priority, the Hot Air Gun requests full power: the gun keeps min_share
+	b.init(700);
+	b.priority(false);
+	p = steady(b, 700, max_gun_pwm, max_iron_pwm);
+	printf("iron first, gun 99: gun %u half-waves, iron %u of %u ticks, %u W\n",
+		(unsigned)p.gun, (unsigned)p.iron, (unsigned)p.iron_req, (unsigned)p.watts);
+	CHECK(p.gun * 100 >= max_gun_pwm * min_share);
+	// The IRON requests a half: it gets all the power requested, the debt is paid back within the TIM1 period
+	b.init(700);
+	p = steady(b, 700, max_gun_pwm, 1000);
+	printf("iron first, iron 50%%: gun %u half-waves, iron %u of %u ticks, %u W\n",
+		(unsigned)p.gun, (unsigned)p.iron, (unsigned)p.iron_req, (unsigned)p.watts);
+	CHECK(p.iron == p.iron_req);
+	CHECK(p.gun * 100 >= max_gun_pwm * min_share);
+
+	// The budget 700 W is below 772 W of both heaters: they are never on together
+	CHECK(b.statistics(PWR_PEAK_W) <= 700);
+	CHECK(b.statistics(PWR_IRON_CUT) > 0);
+	// The budget above both heaters: no limits
+	PWR_BUDGET	full;
+	full.init(800);
+	p = steady(full, 800, max_gun_pwm, 1000);
+	CHECK(p.gun == max_gun_pwm && p.iron == p.iron_req);
+	CHECK(full.statistics(PWR_PEAK_W) == 772);
+	return checkResult();
+}
@@ -0,0 +1,112 @@
+/*
+ * burst_sim.cpp
+ *
+ *  The Hot Air Gun burst fire (see BURST) against the contiguous block of N half-waves in TIM1 period (PWM mode).
+ *  The flicker: every fired half-wave drops the mains voltage by the same step. The voltage fluctuation is weighted
+ *  by the lamp-eye response of IEC 61000-4-15 flickermeter (the 230 V lamp); the result is the rms of the weighted
+ *  fluctuation, relative to the voltage step. The heater ripple: the first order heater element with the time
+ *  constant of 5 seconds (assumed), peak to peak, in percents of the full power temperature rise
+ */
+
+#include <complex>
+#include "check.h"
+#include "gun.h"
+
+typedef std::complex<double> CPLX;
+
+static const uint16_t	half_waves	= 100;					// TIM1 period
+static const uint16_t	window		= 2 * half_waves;		// The burst pattern repeats in 2 seconds at most
+static const double		heater_T	= 5.0;					// The heater element time constant, seconds
+
+// IEC 61000-4-15 weighting filter of the lamp-eye response, 230 V lamp. The maximum (1.0) is at 8.8 Hz
+static double weight(double f) {
+	const double k	= 1.74802;
+	const double l	= 2 * M_PI * 4.05981;
+	const double w1	= 2 * M_PI * 9.15494;
+	const double w2	= 2 * M_PI * 2.27979;
+	const double w3	= 2 * M_PI * 1.22535;
+	const double w4	= 2 * M_PI * 21.9;
+	CPLX s(0, 2 * M_PI * f);
+	CPLX K = k * w1 * s / (s*s + 2.0*l*s + w1*w1) * (1.0 + s/w2) / ((1.0 + s/w3) * (1.0 + s/w4));
+	return abs(K);
+}
+
+// The rms of the weighted periodic fluctuation, the spectrum lines are 0.5 Hz apart (100 half-waves per second)
+static double flicker(const bool *on) {
+	double sum = 0;
+	for (uint16_t k = 1; k <= window/2; ++k) {
+		CPLX X = 0;
+		for (uint16_t i = 0; i < window; ++i)
+			if (on[i]) X += std::polar(1.0, -2 * M_PI * k * i / window);
+		double a = abs(X) * ((k == window/2)?1:2) / window;	// The sine amplitude of the line
+		double w = a * weight(k * 100.0 / window);
+		sum += w * w / 2;
+	}
+	return sqrt(sum);
+}
+
+static double ripple(const bool *on) {
+	double t = 0, t_min = 1, t_max = 0;
+	for (uint16_t r = 0; r < 100; ++r) {					// Settle
+		for (uint16_t i = 0; i < window; ++i) {
+			t += ((on[i]?1.0:0.0) - t) / (heater_T * half_waves);
+			if (r == 99) {
+				t_min = std::min(t_min, t);
+				t_max = std::max(t_max, t);
+			}
+		}
+	}
+	return (t_max - t_min) * 100;
+}
+
+int main(void) {
+	double b_flicker[half_waves], s_flicker[half_waves], b_ripple[half_waves], s_ripple[half_waves];
+	printf("  N  block: flicker ripple,%%   burst: flicker ripple,%%\n");
+	for (uint16_t n = 1; n < half_waves; ++n) {
+		bool block[window], burst[window];
+		BURST b;
+		b.reset();
+		b.setPower(n);
+		for (uint16_t r = 0; r < 3; ++r) {					// The last pattern is taken
+			for (uint16_t i = 0; i < window; ++i) {
+				burst[i] = b.fire(i % half_waves);
+				block[i] = (i % half_waves) < n;
+			}
+		}
+		b_flicker[n] = flicker(block);
+		s_flicker[n] = flicker(burst);
+		b_ripple[n]	 = ripple(block);
+		s_ripple[n]	 = ripple(burst);
+		if (n % 5 == 0 || BURST::isSpread(n))
+			printf("%3d %14.4f %9.2f %16.4f %9.2f%s\n", n, b_flicker[n], b_ripple[n], s_flicker[n], s_ripple[n],
+					BURST::isSpread(n)?"  spread":"");
+	}
+
+	// Whenever the power is spread, the flicker is not worse and the ripple is smaller
+	for (uint16_t n = 1; n < half_waves; ++n) {
+		if (BURST::isSpread(n)) {
+			CHECK(s_flicker[n] <= b_flicker[n] * 1.001);
+			CHECK(s_ripple[n] < b_ripple[n]);
+		} else {
+			CHECK(s_flicker[n] == b_flicker[n]);			// The contiguous block
+		}
+	}
+	// The spreading of any other power would make the flicker worse: N/2 Hz is close to the eye sensitivity peak
+	const uint16_t worse[4] = {7, 20, 47, 80};
+	for (uint8_t i = 0; i < 4; ++i) {
+		uint16_t n = worse[i];
+		bool spread[window];
+		uint16_t acc = 0;
+		bool on = false;
+		for (uint16_t i = 0; i < window; ++i) {				// The sigma-delta as in BURST::fire()
+			if ((i & 1) == 0) {
+				acc	+= n;
+				on	= (acc >= half_waves);
+				if (on) acc -= half_waves;
+			}
+			spread[i] = on;
+		}
+		CHECK(flicker(spread) > b_flicker[n]);
+	}
+	return checkResult();
+}
@@ -0,0 +1,30 @@
+/*
+ * check.h
+ *
+ *  The minimal check macro for the host tests: the failed condition is printed, the test returns non-zero
+ */
+
+#ifndef CHECK_H_
+#define CHECK_H_
+
+#include <stdio.h>
+
+static int check_failed = 0;
+
+#define CHECK(cond) do { \
+		if (!(cond)) { \
+			printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+			++check_failed; \
+		} \
+	} while (0)
+
+static inline int checkResult(void) {
+	if (check_failed) {
+		printf("%d check(s) failed\n", check_failed);
+		return 1;
+	}
+	printf("OK\n");
+	return 0;
+}
+
+#endif
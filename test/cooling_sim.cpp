@@ -0,0 +1,138 @@
+/*
+ * cooling_sim.cpp
+ *
+ *  The Hot Air Gun cooldown (see HOTGUN::coolFan()) on the simulated heater element and the thermocouple.
+ *  The element is cooled by the airflow: the drop per second is (h_nat + h_fan * (fan/1999)**e) * T, where T is the element
+ *  temperature above ambient. The thermocouple follows the element with the first order lag.
+ *  The plants are assumed: about 2 minutes from 500 to 50 Celsius at the full fan speed, the faster and the slower ones,
+ *  the airflow not proportional to the fan PWM (e < 1), the slow thermocouple.
+ *  The element cooling rate is checked against the safe limit (max_cool_grad, 12 internal units per period) for the whole
+ *  cooldown: the first one, while the model is learned, and the next one with the learned model.
+ *  The minimum fan speed can exceed the limit on the hot element, then the rate at the minimum speed is allowed
+ */
+
+#include <math.h>
+#include <random>
+#include "check.h"
+#include "gun.h"
+#include "tools.h"
+
+static const uint16_t	temp_set	= 1290;					// About 400 Celsius
+static const uint16_t	sub_steps	= 50;					// The temperature is read 50 times per TIM1 period
+static const uint32_t	max_periods	= 600;
+static const double		limit		= 12;					// max_cool_grad, internal units per period
+static const uint16_t	min_fan		= 600;					// HOTGUN::min_fan_speed
+static const uint16_t	max_fan		= 1999;
+
+typedef struct {
+	const char	*name;
+	double		h_fan, h_nat, e;							// The element cooling, 1/s
+	double		tau;										// The thermocouple lag, s
+} t_plant;
+
+typedef enum { PROF_FW = 0, PROF_LINEAR, PROF_FULL } t_profile;
+
+typedef struct {
+	uint32_t	periods;									// The time to cold (TIM1 periods)
+	double		max_rate;									// The maximum element cooling rate (units per period)
+	double		max_excess;									// The maximum rate over the allowed one, relative
+	uint32_t	at_limit;									// The periods at the limit with the fan between min and max speed
+	uint32_t	predicted;									// The time to cold predicted after 10 periods of cooling, s (firmware)
+} t_result;
+
+class ELEMENT {
+	public:
+		ELEMENT(const t_plant &p, double t) : p(p), te(t), ts(t)	{ }
+		double		h(uint16_t fan)							{ return p.h_nat + p.h_fan * pow(fan / (double)max_fan, p.e); }
+		void		step(uint16_t fan, double dt)			{ te -= h(fan) * te * dt; ts += (te - ts) * dt / p.tau; }
+		t_plant		p;
+		double		te, ts;									// The element and the thermocouple temperatures
+};
+
+static uint16_t linearFan(double t) {						// The former profile, used till the model is learned
+	return constrain(map(lround(t), 100, temp_set, 1600, min_fan), min_fan, max_fan);
+}
+
+static t_result coolDown(HOTGUN &gun, const t_plant &pl, t_profile profile) {
+	ELEMENT el(pl, temp_set);
+	std::mt19937 gen(1);
+	std::normal_distribution<double> noise(0.0, 2.0);
+	for (uint16_t i = 0; i < 100; ++i) {
+		gun.updateFanCurrent(1500);							// The Hot Air Gun is connected
+		gun.updateTemp(temp_set);
+	}
+	TIM2->CCR2 = min_fan;
+	gun.setTemp(temp_set);
+	gun.switchPower(false);									// Start cooling
+	t_result r = {0, 0, 0, 0, 0};
+	uint16_t fan = min_fan;
+	for (uint32_t n = 0; n < max_periods; ++n) {
+		double te = el.te;
+		double allowed = std::max(limit, el.h(min_fan) * te);	// The element rate at the minimum fan speed
+		for (uint16_t s = 0; s < sub_steps; ++s) {
+			el.step(fan, 1.0 / sub_steps);
+			gun.updateTemp(lround(el.ts + noise(gen)));
+			gun.updateFanCurrent(1500);
+		}
+		double rate = te - el.te;
+		r.max_rate		= std::max(r.max_rate, rate);
+		r.max_excess	= std::max(r.max_excess, rate / allowed - 1);
+		if (fan > min_fan && fan < max_fan && fabs(rate - limit) < 1) ++r.at_limit;
+		HAL_SetTick(HAL_GetTick() + 1000);
+		gun.power();
+		if (n == 10 && profile == PROF_FW) r.predicted = gun.timeToCold();
+		if (profile == PROF_FW) {
+			fan = TIM2->CCR2;
+			if (fan == 0) {									// The gun is cold, shutdown
+				r.periods = n + 1;
+				break;
+			}
+		} else {
+			if (el.ts < 100) {
+				r.periods = n + 1;
+				break;
+			}
+			fan = (profile == PROF_FULL)?max_fan:linearFan(el.ts);
+		}
+	}
+	return r;
+}
+
+int main(void) {
+	const t_plant plants[4] = {
+		{"nominal",		0.023, 0.002, 1.0, 3.0},
+		{"airflow^0.8",	0.023, 0.002, 0.8, 3.0},
+		{"fast",		0.035, 0.002, 0.8, 3.0},
+		{"slow sensor",	0.015, 0.002, 1.0, 5.0}
+	};
+	HAL_SetTick(1000);
+	printf("plant         cooldown   time,s  max rate  excess,%%  at limit  predicted,s\n");
+	for (uint8_t i = 0; i < 4; ++i) {
+		const t_plant &p = plants[i];
+		HOTGUN gun;
+		gun.init();
+		t_result first	= coolDown(gun, p, PROF_FW);		// The cooling model is learned
+		t_result next	= coolDown(gun, p, PROF_FW);		// The model is learned already
+		HOTGUN ref;
+		ref.init();
+		t_result linear	= coolDown(ref, p, PROF_LINEAR);
+		t_result full	= coolDown(gun, p, PROF_FULL);
+		const char *name[4] = {"first", "learned", "linear", "full fan"};
+		t_result *r[4] = {&first, &next, &linear, &full};
+		for (uint8_t j = 0; j < 4; ++j)
+			printf("%-13s %-9s %7u %9.1f %9.1f %9u %12u\n", p.name, name[j], r[j]->periods, r[j]->max_rate,
+					r[j]->max_excess * 100, r[j]->at_limit, r[j]->predicted);
+
+		// The full fan speed would cool the element much faster than the limit: the limit is active
+		CHECK(full.max_rate > 1.5 * limit);
+		// The element never cools faster than allowed, the sensor lag and the noise give up to 10%
+		CHECK(first.max_excess < 0.1);
+		CHECK(next.max_excess < 0.1);
+		// The limit is reached, the cooldown is not much longer than at the full fan speed
+		CHECK(first.at_limit > 10 && next.at_limit > 10);
+		CHECK(next.periods < full.periods * 1.6);
+		// The time to cold is predicted within 20% after 10 periods of cooling
+		CHECK(fabs(next.predicted - (next.periods - 11.0)) < 0.2 * next.periods);
+	}
+	return checkResult();
+}
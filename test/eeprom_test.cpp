@@ -0,0 +1,243 @@
+/*
+ * eeprom_test.cpp
+ *
+ *  The EEPROM layout upgrade on the simulated at24c32a: the configuration records written by the old firmware
+ *  into the whole configuration area [0-63] and the old tip area with two 16-bytes records per chunk.
+ *  The tip area conversion is interrupted by the power loss at every write and completed on the next start
+ */
+
+#include <string.h>
+#include "check.h"
+#include "eeprom.h"
+
+static I2C_HandleTypeDef	hi2c;
+
+// The same checksum as EEPROM::CFG_checkSum()
+static void putRecord(uint16_t chunk, uint32_t ID, uint16_t iron_temp) {
+	RECORD r;
+	memset(&r, 0, sizeof(RECORD));
+	r.ID		= ID;
+	r.iron_temp	= iron_temp;
+	uint16_t summ = 117;
+	uint8_t *d = (uint8_t*)&r;
+	for (uint8_t i = 0; i < sizeof(RECORD); ++i) {
+		summ <<= 1; summ += d[i];
+	}
+	r.crc = summ;
+	memset(&sim_eeprom[chunk * eeprom_chunk_size], 0xFF, eeprom_chunk_size);
+	memcpy(&sim_eeprom[chunk * eeprom_chunk_size], &r, sizeof(RECORD));
+}
+
+// The old firmware rotated the records in 64 chunks. newest is the chunk with the last saved record
+static void oldRing(uint16_t newest) {
+	memset(sim_eeprom, 0xFF, sizeof(sim_eeprom));
+	for (uint16_t i = 0; i < 64; ++i) {
+		uint16_t chunk = (newest + 1 + i) % 64;				// From the oldest record to the newest one
+		putRecord(chunk, 1000 + i, 200 + i);
+	}
+}
+
+static void upgrade(uint16_t newest) {
+	oldRing(newest);
+	EEPROM *e = new EEPROM(&hi2c);
+	CHECK(e->init());
+	RECORD r;
+	CHECK(e->loadRecord(&r));
+	CHECK(r.iron_temp == 263);								// The newest record is loaded
+	PID_SCHEDULE s;
+	memset(&s, 0, sizeof(s));
+	s.power_budget = 5;
+	CHECK(e->saveSchedule(&s));								// The chunk 63 is taken by the schedule
+	GUN_MODEL m;
+	memset(&m, 0, sizeof(m));
+	m.K = 480; m.T = 60; m.L = 3;
+	m.fan_pwm[0] = 900; m.fan_cur[0] = 350;					// The fan reference point, see FAN_REG
+	CHECK(e->saveGunModel(&m));								// The chunk 62 is taken by the Hot Air Gun model
+	delete e;
+
+	e = new EEPROM(&hi2c);									// The next start
+	CHECK(e->init());
+	CHECK(e->loadRecord(&r));
+	CHECK(r.iron_temp == 263);
+	CHECK(e->loadSchedule(&s) && s.power_budget == 5);
+	r.iron_temp = 300;
+	CHECK(e->saveRecord(&r));
+	delete e;
+
+	e = new EEPROM(&hi2c);
+	CHECK(e->init());
+	CHECK(e->loadRecord(&r));
+	CHECK(r.iron_temp == 300);
+	CHECK(e->loadSchedule(&s) && s.power_budget == 5);
+	CHECK(e->loadGunModel(&m) && m.K == 480 && m.T == 60 && m.L == 3);
+	CHECK(m.fan_pwm[0] == 900 && m.fan_cur[0] == 350 && m.fan_cur[1] == 0);
+	delete e;
+}
+
+// Every bit of the system records is covered by the CRC: the damaged record is not loaded
+static void damageSysRecords(void) {
+	memset(sim_eeprom, 0xFF, sizeof(sim_eeprom));
+	EEPROM *e = new EEPROM(&hi2c);
+	CHECK(e->init());
+	PID_SCHEDULE s;
+	memset(&s, 0, sizeof(s));
+	s.Kp[0] = 2770; s.power_budget = 7;
+	CHECK(e->saveSchedule(&s));
+	GUN_MODEL m;
+	memset(&m, 0, sizeof(m));
+	m.K = 480; m.fan_cur[4] = 350;
+	CHECK(e->saveGunModel(&m));
+	uint16_t missed = 0;
+	for (uint16_t chunk = 62; chunk <= 63; ++chunk) {
+		uint8_t size = (chunk == 63)?sizeof(PID_SCHEDULE):sizeof(GUN_MODEL);
+		uint8_t *rec = &sim_eeprom[chunk * eeprom_chunk_size];
+		for (uint16_t bit = 16; bit < size * 8; ++bit) {	// The signature is checked separately
+			rec[bit >> 3] ^= 1 << (bit & 7);
+			e->forceReloadChunk();
+			bool loaded = (chunk == 63)?e->loadSchedule(&s):e->loadGunModel(&m);
+			if (loaded) ++missed;
+			rec[bit >> 3] ^= 1 << (bit & 7);
+		}
+	}
+	e->forceReloadChunk();
+	CHECK(e->loadSchedule(&s) && s.Kp[0] == 2770 && s.power_budget == 7);
+	CHECK(e->loadGunModel(&m) && m.K == 480 && m.fan_cur[4] == 350);
+	printf("system records: %u damaged bits missed\n", (unsigned)missed);
+	CHECK(missed == 0);
+	delete e;
+}
+
+// The same checksum as EEPROM::TIP_checkSum()
+static void tipCheckSum(TIP *tip) {
+	uint32_t summ = tip->t200;
+	summ <<= 1; summ += tip->t260;
+	summ <<= 1; summ += tip->t330;
+	summ <<= 1; summ += tip->t400;
+	summ <<= 1; summ += tip->mask;
+	summ <<= 1; summ += tip->ambient;
+	for (int i = 0; i < tip_name_sz; ++i) {
+		summ <<= 1; summ += (uint8_t)tip->name[i];
+	}
+	tip->crc = (summ + 117) & 0xFF;
+}
+
+// The old tip record number n in the slot of the old tip area (two records per chunk)
+static void putOldTip(uint16_t slot, uint16_t n) {
+	TIP tip;
+	memset(&tip, 0, sizeof(TIP));
+	tip.name[0]	= 'T';
+	tip.name[1]	= '0' + n / 100 % 10;
+	tip.name[2]	= '0' + n / 10 % 10;
+	tip.name[3]	= '0' + n % 10;
+	tip.t200	= 1000 + n;
+	tip.t260	= 1300 + n;
+	tip.t330	= 1600 + n;
+	tip.t400	= 1900 + n;
+	tip.mask	= TIP_ACTIVE | TIP_CALIBRATED;
+	tipCheckSum(&tip);
+	memcpy(&sim_eeprom[64 * eeprom_chunk_size + slot * TIP_OLD_SIZE], &tip, TIP_OLD_SIZE);
+}
+
+// The old tip area: the records in the slots (every step-th slot starting from the first one)
+static uint16_t oldTipArea(uint16_t first, uint16_t step, uint16_t records) {
+	memset(sim_eeprom, 0xFF, sizeof(sim_eeprom));
+	uint16_t n = 0;
+	for (uint16_t slot = first; slot < 128 && n < records; slot += step)
+		putOldTip(slot, n++);
+	return n;
+}
+
+// Every tip is found once with the correct calibration data
+static bool checkTips(EEPROM *e, uint16_t records, uint16_t total) {
+	uint8_t found[128];
+	memset(found, 0, sizeof(found));
+	for (uint16_t i = 0; i < total; ++i) {
+		TIP tip;
+		if (e->loadTipData(&tip, i) != EPR_OK) continue;
+		int n = atoi(&tip.name[1]);
+		if (n < 0 || n >= records || tip.t200 != 1000 + n || tip.t400 != 1900 + n || tip.Kp != 0) return false;
+		++found[n];
+	}
+	for (uint16_t n = 0; n < records; ++n)
+		if (found[n] != 1) return false;
+	return true;
+}
+
+static EEPROM* start(void) {
+	EEPROM *e = new EEPROM(&hi2c);
+	e->init();
+	e->migrateTipArea();
+	return e;
+}
+
+static void convertTips(uint16_t first, uint16_t step, uint16_t records) {
+	oldTipArea(first, step, records);
+	static uint8_t image[4096];
+	memcpy(image, sim_eeprom, sizeof(image));
+	EEPROM *e = start();
+	CHECK(!e->isOldTipArea());
+	CHECK(checkTips(e, records, 64));
+	PID_SCHEDULE s;
+	CHECK(e->loadSchedule(&s) && s.tip_layout == 1);
+	delete e;
+
+	// The converted area is not checked again: the old record written after the conversion is not converted
+	uint8_t chunk[eeprom_chunk_size];
+	uint16_t last = 127 * eeprom_chunk_size;
+	putOldTip(127, 200);
+	memcpy(chunk, &sim_eeprom[last], eeprom_chunk_size);
+	e = start();
+	CHECK(memcmp(chunk, &sim_eeprom[last], eeprom_chunk_size) == 0);
+	delete e;
+
+	// The power is lost at every write of the conversion
+	uint16_t lost = 0;
+	for (int32_t w = 1; w < 200; ++w) {
+		memcpy(sim_eeprom, image, sizeof(image));
+		sim_eeprom_writes_left = w;
+		delete start();
+		bool interrupted = (sim_eeprom_writes_left == 0);
+		sim_eeprom_writes_left = -1;
+		e = start();										// The next start completes the conversion
+		if (!checkTips(e, records, 64) || e->isOldTipArea())
+			++lost;
+		delete e;
+		if (!interrupted) break;
+	}
+	printf("%d tips from slot %d step %d: %s\n", records, first, step, lost?"LOST":"converted on every power loss");
+	CHECK(lost == 0);
+}
+
+// Too many tips to be converted: the old area is used as is
+static void keepOldTips(uint16_t records) {
+	oldTipArea(0, 1, records);
+	EEPROM *e = start();
+	CHECK(e->isOldTipArea());
+	CHECK(checkTips(e, records, 128));
+	TIP tip;
+	CHECK(e->loadTipData(&tip, 10) == EPR_OK);
+	tip.Kp		= 100;
+	tip.t400	= 1900 + 10;
+	CHECK(e->saveTipData(&tip, 10) == EPR_OK);				// The neighbor record is not damaged
+	CHECK(checkTips(e, records, 128));
+	delete e;
+	e = start();											// The next start checks the area again
+	CHECK(e->isOldTipArea());
+	delete e;
+}
+
+int main(void) {
+	damageSysRecords();
+	upgrade(63);											// The newest record is in the chunk taken by the schedule
+	upgrade(10);
+	upgrade(62);											// The newest record is in the chunk taken by the model
+	upgrade(0);
+	convertTips(0, 1, 40);									// Both records in the first 20 chunks
+	convertTips(1, 2, 40);									// The second record in 40 chunks
+	convertTips(0, 3, 43);									// Mixed
+	convertTips(0, 2, 63);									// The first record in 63 chunks
+	convertTips(0, 1, 63);
+	keepOldTips(64);
+	keepOldTips(100);
+	return checkResult();
+}
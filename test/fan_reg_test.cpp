@@ -0,0 +1,81 @@
+/*
+ * fan_reg_test.cpp
+ *
+ *  The Hot Air Gun fan regulator (see FAN_REG) on the simulated fan: the current is proportional to the fan PWM,
+ *  the supply voltage and the airflow. The reference currents are learned once per speed with the clear nozzle
+ *  and kept over the restarts, so the blocked nozzle is detected after the power-on and the speed change
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "check.h"
+#include "gun.h"
+
+typedef struct {
+	double		voltage;										// The fan supply voltage, relative to nominal
+	double		airflow;										// 1.0 - the clear nozzle
+} t_fan;
+
+static int32_t fanCurrent(const t_fan &fan, uint16_t pwm) {
+	return lround(pwm * 0.4 * fan.voltage * fan.airflow);
+}
+
+// Run the regulator for some periods, return the last fan PWM
+static uint16_t run(FAN_REG &reg, const t_fan &fan, uint16_t start_pwm, uint16_t periods) {
+	uint16_t pwm = start_pwm;
+	for (uint16_t n = 0; n < periods; ++n)
+		pwm = reg.pwm(fanCurrent(fan, pwm));
+	return pwm;
+}
+
+int main(void) {
+	FAN_REG reg;
+	t_fan clear		= {1.0, 1.0};
+	t_fan blocked	= {1.0, 0.4};
+	t_fan low_volt	= {0.9, 1.0};
+
+	CHECK(reg.referencePoints() == 0 && !reg.referenceChanged());
+	reg.start(1000);											// The first power-on: the reference is learned
+	run(reg, clear, 1000, 20);
+	CHECK(!reg.isFailed());
+	CHECK(reg.referencePoints() == 1 && reg.referenceChanged());
+	CHECK(!reg.referenceChanged());							// The flag is cleared when read
+
+	reg.start(1000);											// The power-on with the blocked nozzle: no new reference
+	run(reg, blocked, 1000, 20);
+	CHECK(reg.isFailed());
+	CHECK(reg.referencePoints() == 1 && !reg.referenceChanged());
+
+	reg.start(1050);											// The close speed uses the learned point
+	run(reg, blocked, 1050, 20);
+	CHECK(reg.isFailed());
+	CHECK(reg.referencePoints() == 1);
+
+	reg.start(1600);											// Far speed, clear nozzle: new point learned
+	run(reg, clear, 1600, 20);
+	CHECK(!reg.isFailed() && reg.referencePoints() == 2 && reg.referenceChanged());
+	reg.start(1300);											// Between the learned points: interpolated
+	run(reg, blocked, 1300, 20);
+	CHECK(reg.isFailed() && reg.referencePoints() == 2);
+
+	reg.start(1300);											// The supply voltage drop is compensated by the fan PWM
+	uint16_t pwm = run(reg, low_volt, 1300, 100);
+	CHECK(!reg.isFailed());
+	CHECK(abs(fanCurrent(low_volt, pwm) - fanCurrent(clear, 1300)) <= 2);
+
+	uint16_t p[FAN_REF_POINTS], c[FAN_REF_POINTS];			// The points are restored after the reboot
+	reg.dumpReference(p, c);
+	FAN_REG next;
+	next.loadReference(p, c);
+	CHECK(next.referencePoints() == 2 && !next.referenceChanged());
+	next.start(1000);
+	run(next, blocked, 1000, 20);
+	CHECK(next.isFailed());
+
+	next.clearReference();										// The nozzle was cleaned: learn again
+	CHECK(next.referencePoints() == 0 && next.referenceChanged());
+	next.start(1000);
+	run(next, clear, 1000, 20);
+	CHECK(!next.isFailed() && next.referencePoints() == 1);
+	return checkResult();
+}
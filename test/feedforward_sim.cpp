@@ -0,0 +1,84 @@
+/*
+ * feedforward_sim.cpp
+ *
+ *  The IRON feedforward power on the simulated T12 tip. The feedforward coefficient is learned by the IRON class
+ *  in steady state (see IRON::learnedFeedForward()), then the heat-up, the preset temperature change and
+ *  the load recovery are compared with the pure feedback control
+ */
+
+#include <random>
+#include "check.h"
+#include "plant.h"
+#include "iron.h"
+#include "tools.h"
+
+static const uint16_t	max_iron_pwm	= 1960;				// See core.cpp
+
+typedef struct {
+	double		time;										// The time to stay within 1% of the preset temperature, seconds
+	double		dev;										// The maximum deviation from the preset temperature after the event
+} t_result;
+
+class SIM {
+	public:
+		SIM(uint8_t ff_k) : tip(t12Plant()), gen(1), noise(0.0, 2.0) {
+			HAL_SetTick(1);
+			TIM2->CCR1 = 0;
+			iron.init();
+			iron.load(PIDparam(2300, 50, 735));				// The default IRON PID coefficients, see config.cpp
+			iron.setFeedForward(ff_k);
+		}
+		// Run the control with the preset temperature t_set for the period, return the settling time and the deviation
+		t_result	run(uint16_t t_set, double seconds, double load = 0) {
+			iron.setTemp(t_set);
+			if (!iron.isOn()) iron.switchPower(true);
+			tip.load(load);
+			uint32_t periods = seconds * 50, last_out = 0;
+			double dev = 0;
+			for (uint32_t n = 0; n < periods; ++n) {
+				int32_t t = lround(tip.read() + noise(gen));
+				uint16_t p = constrain(iron.power(constrain(t, 0, 4095)), 0, max_iron_pwm);
+				TIM2->CCR1 = p;								// The power applied, see controlTask()
+				tip.step(p / 2000.0);
+				HAL_SetTick(HAL_GetTick() + 20);
+				double d = fabs(tip.read() - t_set);
+				if (d > t_set * 0.01) last_out = n + 1;
+				if (load > 0 || tip.read() > t_set) dev = std::max(dev, d);	// The dip under load or the overshoot
+			}
+			t_result r = {last_out * 0.02, dev};
+			return r;
+		}
+		IRON		iron;
+	private:
+		PLANT		tip;
+		std::mt19937 gen;
+		std::normal_distribution<double> noise;
+};
+
+int main(void) {
+	SIM *learn = new SIM(0);
+	learn->run(3000, 120);
+	uint8_t k = learn->iron.learnedFeedForward();
+	delete learn;
+	printf("learned feedforward coefficient: %d (the plant needs %.1f)\n", k, 3000.0 / 15000 * 2000 * 128 / 3000);
+	CHECK(k >= 16 && k <= 18);
+
+	t_result r[2][3];
+	for (uint8_t i = 0; i < 2; ++i) {
+		SIM *s = new SIM(i?k:0);
+		r[i][0] = s->run(3000, 60);							// Heat-up from cold
+		r[i][1] = s->run(3500, 60);							// The preset temperature raised
+		r[i][2] = s->run(3500, 60, 3000);					// The soldered joint
+		delete s;
+	}
+	const char *name[3] = {"heat-up 0->3000", "preset 3000->3500", "load recovery"};
+	printf("%-20s %-22s %s\n", "", "feedback: time, dev", "feedforward: time, dev");
+	for (uint8_t e = 0; e < 3; ++e)
+		printf("%-20s %8.2f s %8.1f %12.2f s %8.1f\n", name[e], r[0][e].time, r[0][e].dev, r[1][e].time, r[1][e].dev);
+	CHECK(r[1][0].time < r[0][0].time * 0.7);
+	CHECK(r[1][2].time < r[0][2].time * 0.7);
+	// The small preset change is driven by the integral term: the feedforward adds the steady power difference only
+	CHECK(r[1][1].time < r[0][1].time + 0.5);
+	CHECK(r[1][1].dev <= r[0][1].dev);
+	return checkResult();
+}
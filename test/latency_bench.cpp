@@ -0,0 +1,83 @@
+/*
+ * latency_bench.cpp
+ *
+ *  The ADC interrupt work before and after the control task was moved to PendSV. The encoder, TIM1 and ADC interrupts
+ *  have the same priority, so the longest ADC interrupt is the worst-case latency added to the encoder and the
+ *  Hot Air Gun power interrupts. The same firmware code is timed on the host: the absolute numbers are host time,
+ *  the ratio shows how much of the interrupt work was deferred. On the board see the debug profile page (ADC, CTL)
+ */
+
+#include <chrono>
+#include "check.h"
+#include "oversample.h"
+#include "ring.h"
+#include "stat.h"
+#include "pid.h"
+#include "tools.h"
+
+typedef OVERSAMPLER<2, 4> ADC_WIN;								// ADC_CONV and ADC_LOOPS in core.cpp
+static const uint32_t	slot_gun_temp	= ADC1_SLOT(0);
+static const uint32_t	slot_ambient	= ADC1_SLOT(1);
+static const uint32_t	slot_iron_temp	= ADC2_SLOT(0) | ADC2_SLOT(1);
+static const int		loops			= 1000000;
+
+typedef struct s_temp_sample {
+	uint16_t	iron;
+	uint16_t	ambient;
+} t_temp_sample;
+
+static uint16_t						data[ADC_WIN::size];
+static RING<t_temp_sample, 4>		temp_ring;
+static EMP_AVERAGE					t_amb(10), h_temp(20), d_temp(20), h_power(20), d_power(20), gun_temp(10);
+static ALPHA_BETA					t_iron;
+static THERMAL_GUARD				guard(1999, 3, 256, 25, 150, 400, 25);
+static PID_ENGINE<11, 0, 1999>		pid;
+static volatile uint32_t			sink;
+
+// The interrupt before: the window average and the whole IRON control step (IRON::power())
+static void before(uint16_t set) {
+	uint32_t iron	= ADC_WIN::average<slot_iron_temp>(data);
+	gun_temp.update(ADC_WIN::average<slot_gun_temp>(data));
+	t_amb.update(ADC_WIN::average<slot_ambient>(data));
+	t_iron.update(iron, h_power.read());
+	int32_t t		= t_iron.read();
+	guard.check(t, iron, h_power.read(), true);
+	int32_t at		= h_temp.average(t);
+	d_temp.update((at - t)*(at - t));
+	pid.feedForward((40 * set + 64) >> 7);
+	int32_t p		= constrain(pid.reqPower(set, t), 0, 1999);
+	int32_t ap		= h_power.average(p);
+	d_power.update((ap - p)*(ap - p));
+	sink			= p;
+}
+
+// The interrupt after: the window average, the Hot Air Gun temperature and the ring
+static void after(void) {
+	gun_temp.update(ADC_WIN::average<slot_gun_temp>(data));
+	t_temp_sample sample;
+	sample.iron		= ADC_WIN::average<slot_iron_temp>(data);
+	sample.ambient	= ADC_WIN::average<slot_ambient>(data);
+	temp_ring.push(sample);
+	temp_ring.pop(sample);										// Done by the control task, not timed on the board
+	sink			= sample.iron;
+}
+
+template <typename F>
+static double time(F f) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < loops; ++i) {
+		data[i & 15] = 1500 + (i & 7);							// Change the window to prevent the caching of the results
+		f(i);
+	}
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / loops;
+}
+
+int main(void) {
+	HAL_SetTick(0);
+	pid.load(PIDparam(2770, 50, 7000));
+	double ns_before	= time([](int i) { before(1600 + (i & 1)); });
+	double ns_after		= time([](int) { after(); });
+	printf("ADC interrupt work, host ns: before %.1f, after %.1f (%.0f%%)\n", ns_before, ns_after, 100.0*ns_after/ns_before);
+	CHECK(ns_after < ns_before);
+	return checkResult();
+}
@@ -0,0 +1,97 @@
+/*
+ * oversample_test.cpp
+ *
+ *  The effective number of bits (ENOB) of the IRON thermocouple channel against the CPU cost of the window average.
+ *  The synthetic window is filled like DMA does: adc1-rank1, adc2-rank1, adc1-rank2, adc2-rank2, ...
+ *  The IRON channel is sampled by both ADC2 ranks, every sample has the gaussian noise and is quantized to 12 bits
+ *  The decimator sums several windows of the same (slowly changing) temperature and keeps the extra bits
+ */
+
+#include <math.h>
+#include <random>
+#include "check.h"
+#include "oversample.h"
+#include "tools.h"
+
+static const uint32_t	slot_iron_temp	= ADC2_SLOT(0) | ADC2_SLOT(1);	// The same map as in core.cpp
+static const double		noise_lsb		= 1.5;						// The thermocouple amplifier noise (LSB rms)
+static const int		trials			= 20000;
+
+// The CPU cost of the window average is one addition per sample and one division per window
+template <uint8_t loops>
+static double enob(void) {
+	typedef OVERSAMPLER<2, loops> WIN;
+	static uint16_t data[WIN::size];
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<double> level(200.0, 3800.0);
+	std::normal_distribution<double> noise(0.0, noise_lsb);
+	double err2 = 0;
+	for (int n = 0; n < trials; ++n) {
+		double v = level(gen);
+		for (uint16_t i = 0; i < WIN::size; ++i)
+			data[i] = (uint16_t)constrain(lround(v + noise(gen)), 0, 4095);
+		uint32_t avg = WIN::template average<slot_iron_temp>(data);
+		double e = (double)avg - v;
+		err2 += e*e;
+	}
+	double rms = sqrt(err2 / trials);
+	return 12.0 - log2(rms * sqrt(12.0));						// An ideal 12-bit ADC has rms error 1/sqrt(12) LSB
+}
+
+// The CPU cost of the decimator is one addition per sample and one division per 'decim' windows
+template <uint8_t decim>
+static double decimEnob(void) {
+	typedef OVERSAMPLER<2, 4, decim> WIN;
+	static uint16_t data[WIN::size];
+	typename WIN::template DECIMATOR<slot_iron_temp> dec;
+	std::mt19937 gen(1);
+	std::uniform_real_distribution<double> level(200.0, 3800.0);
+	std::normal_distribution<double> noise(0.0, noise_lsb);
+	double err2 = 0;
+	for (int n = 0; n < trials; ++n) {
+		double v = level(gen);
+		bool ready = false;
+		for (uint8_t w = 0; w < decim; ++w) {
+			for (uint16_t i = 0; i < WIN::size; ++i)
+				data[i] = (uint16_t)constrain(lround(v + noise(gen)), 0, 4095);
+			ready = dec.update(data);
+		}
+		if (!ready) return 0;									// Exactly one value per 'decim' windows
+		double e = (double)dec.read() / (1 << WIN::extra_bits) - v;
+		err2 += e*e;
+	}
+	double rms = sqrt(err2 / trials);
+	return 12.0 - log2(rms * sqrt(12.0));
+}
+
+int main(void) {
+	double e1 = enob<1>();
+	double e2 = enob<2>();
+	double e4 = enob<4>();										// ADC_LOOPS in core.cpp
+	double e8 = enob<8>();
+	printf("loops  adds  ENOB\n");
+	printf("%5d %5d %5.2f\n", 1, 2, e1);
+	printf("%5d %5d %5.2f\n", 2, 4, e2);
+	printf("%5d %5d %5.2f\n", 4, 8, e4);
+	printf("%5d %5d %5.2f\n", 8, 16, e8);
+
+	double d1	= decimEnob<1>();
+	double d4	= decimEnob<4>();
+	double d16	= decimEnob<16>();
+	printf("\ndecim  bits  adds/window  div/window  ENOB\n");
+	printf("%5d %5d %12d %11.3f %5.2f\n", 1,  OVERSAMPLER<2, 4, 1>::extra_bits,  8, 1.0,		d1);
+	printf("%5d %5d %12d %11.3f %5.2f\n", 4,  OVERSAMPLER<2, 4, 4>::extra_bits,  8, 1.0/4,	d4);
+	printf("%5d %5d %12d %11.3f %5.2f\n", 16, OVERSAMPLER<2, 4, 16>::extra_bits, 8, 1.0/16,	d16);
+
+	// Every doubling of the samples reduces the noise by sqrt(2): half a bit while the noise dominates the quantization
+	CHECK(e2 > e1 + 0.3);
+	CHECK(e4 > e2 + 0.3);
+	CHECK(e4 > 10.5);
+	// The rounded average cannot be better than the ideal 12-bit quantization
+	CHECK(e8 < 12.1);
+	// The decimator of one window is the window average; the extra bits keep the gain above 12 bits
+	CHECK(fabs(d1 - e4) < 0.05);
+	CHECK(d4 > e4 + 0.7);
+	CHECK(d16 > 12.5);
+	return checkResult();
+}
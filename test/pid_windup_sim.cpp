@@ -0,0 +1,88 @@
+/*
+ * pid_windup_sim.cpp
+ *
+ *  The IRON PID step response on the simulated T12 tip: PID_ENGINE (the clamped accumulator) against
+ *  the former algorithm with the unbounded accumulator, where only the output was limited by the caller.
+ *  The temperature is measured every 50 Hz period with the thermocouple noise
+ */
+
+#include <random>
+#include "check.h"
+#include "plant.h"
+#include "pid.h"
+#include "tools.h"
+
+static const int32_t	max_power	= 1999;
+static const uint32_t	periods		= 6000;					// 120 seconds at 50 Hz
+
+// The former PID::reqPower(): the accumulator winds up while the output is saturated
+class OLD_PID : public PID {
+	public:
+		int32_t		reqPower(int16_t temp_set, int16_t temp_curr) {
+			if (temp_h0 == 0) {
+				i_summ	= temp_set - temp_curr;
+				power	= Kp*(temp_set - temp_curr) + Ki * i_summ;
+			} else {
+				int32_t kp = Kp * (temp_h1 	- temp_curr);
+				int32_t ki = Ki * (temp_set	- temp_curr);
+				int32_t kd = Kd * (temp_h0 	+ temp_curr - 2 * temp_h1);
+				power += kp + ki + kd;
+			}
+			temp_h0 = temp_h1;
+			temp_h1 = temp_curr;
+			return (power + (1 << (denominator_p-1))) >> denominator_p;
+		}
+};
+
+typedef PID_ENGINE<11, 0, 1999> NEW_PID;					// The same as IRON_PID
+
+typedef struct {
+	double		overshoot;									// The maximum tip temperature above the preset one
+	double		settle;										// The time to stay within 1% of the preset temperature, seconds
+} t_result;
+
+template <class CTRL>
+static t_result step(const PIDparam &k, uint16_t from, uint16_t to) {
+	CTRL pid;
+	pid.load(k);
+	PLANT tip = t12Plant();
+	tip.reset(from);
+	std::mt19937 gen(1);
+	std::normal_distribution<double> noise(0.0, 2.0);
+	t_result r = {0, 0};
+	uint32_t last_out = 0;									// The last period out of the 1% band
+	for (uint32_t n = 0; n < periods; ++n) {
+		int32_t t = lround(tip.read() + noise(gen));
+		int32_t p = constrain(pid.reqPower(to, t), 0, max_power);
+		tip.step((double)p / (max_power + 1));
+		r.overshoot = std::max(r.overshoot, tip.read() - to);
+		if (fabs(tip.read() - to) > to * 0.01) last_out = n + 1;
+	}
+	r.settle = last_out * 0.02;
+	return r;
+}
+
+static void compare(const char *name, const PIDparam &k, uint16_t from, uint16_t to, t_result r[2]) {
+	r[0] = step<OLD_PID>(k, from, to);
+	r[1] = step<NEW_PID>(k, from, to);
+	printf("%-28s %4d->%4d  old: %6.1f %6.2f s   new: %6.1f %6.2f s\n", name, from, to,
+			r[0].overshoot, r[0].settle, r[1].overshoot, r[1].settle);
+}
+
+int main(void) {
+	const PIDparam	def(2300, 50, 735);						// The default IRON PID coefficients, see config.cpp
+	const PIDparam	smooth(575, 10, 200);					// The calibration PID coefficients
+	t_result r[2];
+	printf("%-28s %10s  %-20s  %s\n", "coefficients", "step", "overshoot, settle", "overshoot, settle");
+
+	compare("default, cold start", def, 0, 3000, r);
+	CHECK(r[1].overshoot < r[0].overshoot / 2);				// The integral does not wind up during the heat-up
+	CHECK(r[1].settle < r[0].settle);
+	compare("default, preset raised", def, 3000, 3500, r);
+	CHECK(r[1].overshoot <= r[0].overshoot);
+	CHECK(r[1].settle <= r[0].settle);
+	compare("calibration, cold start", smooth, 0, 3000, r);
+	CHECK(r[1].overshoot < r[0].overshoot);
+	CHECK(r[1].settle < r[0].settle);
+	return checkResult();
+}
@@ -0,0 +1,43 @@
+/*
+ * plant.h
+ *
+ *  The simulated heaters for the host tests: the first order plus dead time (FOPDT) thermal plant.
+ *  The temperature is kept in the internal units above ambient, the input is the power fraction 0..1 of the control period.
+ *  The load is the extra heat loss (the soldered joint), in the same units as the full power gain
+ */
+
+#ifndef PLANT_H_
+#define PLANT_H_
+
+#include <stdint.h>
+#include <math.h>
+#include <deque>
+
+class PLANT {
+	public:
+		PLANT(double K, double T, uint16_t L) : K(K), T(T), pipe(L, 0.0)	{ }
+		void		reset(double t = 0)						{ temp = t; for (auto &u : pipe) u = t / K; }	// The steady state at t
+		void		load(double l)							{ extra = l; }
+		double		read(void)								{ return temp; }
+		void		step(double u) {						// One control period with the power fraction u
+			pipe.push_back(u);
+			double d = pipe.front();
+			pipe.pop_front();
+			temp += (K * d - extra - temp) / T;
+			if (temp < 0) temp = 0;
+		}
+	private:
+		double		K;										// The steady temperature at full power
+		double		T;										// The time constant, control periods
+		std::deque<double> pipe;							// The dead time, control periods
+		double		temp	= 0;
+		double		extra	= 0;
+};
+
+/*
+ * The T12 tip: about 6 seconds from cold to 300 Celsius at full power, the dead time is two 50 Hz periods.
+ * The steady power at 300 Celsius (3000 internal units) is about 400 of 1999
+ */
+static inline PLANT t12Plant(void)							{ return PLANT(15000.0, 1500.0, 2); }
+
+#endif
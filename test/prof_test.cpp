@@ -0,0 +1,36 @@
+/*
+ * prof_test.cpp
+ *
+ *  The ISR profiler statistics with long ISRs and many calls: the mean must not overflow,
+ *  the histogram must keep its shape when a bin saturates
+ */
+
+#include "check.h"
+#include "prof.h"
+
+// Simulate the call lasted t time units
+static void call(ISR_PROF &p, uint32_t t) {
+	p.update(ISR_PROF::cycles() - t);
+}
+
+int main(void) {
+	ISR_PROF p;
+	// 200000 calls of about 100000 units: the plain summary would overflow after 43000 calls
+	for (uint32_t i = 0; i < 200000; ++i)
+		call(p, 100000);
+	printf("long ISR mean %u\n", (unsigned)p.meanTime());
+	CHECK(p.meanTime() >= 100000 && p.meanTime() < 100000 + 100000/100);	// The host clock runs while update() is called
+
+	// Two durations in 3:1 ratio, much more calls than a bin can count
+	p.reset();
+	for (uint32_t i = 0; i < 400000; ++i)
+		call(p, (i & 3)?1400:100000);
+	uint8_t	 short_bin	= 10;										// 1400 is in [1024, 2048)
+	uint8_t	 long_bin	= PROF_HIST_SZ-1;							// The last bin counts all the longer calls
+	uint32_t h_short	= p.hist(short_bin);
+	uint32_t h_long		= p.hist(long_bin);
+	printf("histogram short %u long %u\n", (unsigned)h_short, (unsigned)h_long);
+	CHECK(h_short == p.histMax());
+	CHECK(h_long > 0 && h_short > 2*h_long && h_short < 4*h_long);
+	return checkResult();
+}
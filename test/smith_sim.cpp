@@ -0,0 +1,91 @@
+/*
+ * smith_sim.cpp
+ *
+ *  The Hot Air Gun dead time compensation (see SMITH) on the simulated heater with the long dead time.
+ *  The PID is tuned by the AMIGO rule for the whole dead time (as the PID autotune does) and for one period
+ *  of the dead time (the raised coefficients). The raised coefficients overshoot without the predictor and settle
+ *  quickly with it. The predictor model is checked with the gain, the time constant and the dead time errors
+ */
+
+#include <random>
+#include "check.h"
+#include "plant.h"
+#include "gun.h"
+#include "tools.h"
+
+static const uint32_t	tim1_ms		= 1000;					// The TIM1 period, HOTGUN::power() call period
+static const uint16_t	set_temp	= 1200;
+static const uint16_t	band		= 10;					// The settled temperature band
+static const uint16_t	max_power	= 99;
+static const uint32_t	periods		= 600;					// 10 minutes
+
+static const double		plant_K		= 2000;					// The steady temperature at full power
+static const double		plant_T		= 30;					// The time constant, TIM1 periods
+static const uint16_t	plant_L		= 6;					// The dead time, TIM1 periods
+
+typedef struct {
+	double		overshoot;
+	uint32_t	settle;										// The time to enter the band for good, seconds
+} t_result;
+
+// The heat-up from the cold state. model_k == 0 runs the plain PID
+static t_result heatUp(GUN_PID &pid, uint16_t model_k, uint16_t model_t, uint8_t model_l) {
+	PLANT heater(plant_K, plant_T, plant_L);
+	std::mt19937 gen(1);
+	std::normal_distribution<double> noise(0.0, 1.0);
+	SMITH smith;
+	smith.model(model_k, model_t, model_l);
+	pid.resetPID();
+	t_result r = {0, 0};
+	for (uint32_t n = 0; n < periods; ++n) {
+		int32_t t		= lround(heater.read() + noise(gen));
+		int32_t t_fb	= t + smith.correction();			// The same as HOTGUN::power()
+		int32_t p		= constrain(pid.reqPower(set_temp, t_fb), 0, max_power);
+		smith.update(p);
+		heater.step(p / 100.0);
+		double d = heater.read() - set_temp;
+		r.overshoot = std::max(r.overshoot, d);
+		if (fabs(d) > band) r.settle = (n + 1) * tim1_ms / 1000;
+	}
+	return r;
+}
+
+// Heat-up by the PID with and without the predictor, the predictor model with the errors of K, T and L
+static void check(const char *name, GUN_PID &pid, uint16_t K, double max_overshoot, uint32_t max_settle) {
+	const struct { double k, t; int8_t l; } err[7] = {
+		{1.0, 1.0, 0}, {1.2, 1.0, 0}, {0.8, 1.0, 0}, {1.0, 1.3, 0}, {1.0, 0.7, 0}, {1.0, 1.0, 1}, {1.0, 1.0, -1}
+	};
+	for (uint8_t i = 0; i < 7; ++i) {
+		t_result m = heatUp(pid, lround(K * err[i].k), lround(plant_T * err[i].t), plant_L + err[i].l);
+		printf("%-14s   K*%3.1f T*%3.1f L%+d   %9.1f %10u\n", name, err[i].k, err[i].t, err[i].l, m.overshoot, m.settle);
+		CHECK(m.overshoot < max_overshoot);
+		CHECK(m.settle < max_settle);
+	}
+}
+
+int main(void) {
+	uint16_t K	= lround(plant_K / 100.0 * 16);				// Internal units per power unit * 16, see FOPDT
+	FOPDT model	= {K, (uint32_t)(plant_T * tim1_ms), (uint32_t)(plant_L * tim1_ms)};
+	FOPDT fast	= {K, (uint32_t)(plant_T * tim1_ms), tim1_ms};	// One period left of the dead time
+	GUN_PID tuned, raised;
+	CHECK(tuned.modelPIDparams(model, tim1_ms));			// As the PID autotune does, see MAUTOPID
+	CHECK(raised.modelPIDparams(fast, tim1_ms));
+
+	t_result plain	= heatUp(tuned, 0, 1, 0);
+	t_result raw	= heatUp(raised, 0, 1, 0);
+	printf("PID tuning       predictor model    overshoot  settle, s\n");
+	printf("%-14s   none               %9.1f %10u\n", "autotune", plain.overshoot, plain.settle);
+	printf("%-14s   none               %9.1f %10u\n", "raised", raw.overshoot, raw.settle);
+
+	// The autotune coefficients settle quicker with the predictor, the model errors do not add the overshoot.
+	// The too long time constant of the model makes the heat-up a bit slower
+	check("autotune", tuned, K, band, plain.settle * 1.1);
+	CHECK(heatUp(tuned, K, plant_T, plant_L).settle < plain.settle * 0.9);
+	// The raised coefficients overshoot without the predictor; with it they settle twice as fast as the autotune ones.
+	// The too short time constant of the model is the worst case, still better than no predictor
+	CHECK(raw.overshoot > 5 * band);
+	check("raised", raised, K, raw.overshoot, periods / 2);
+	CHECK(heatUp(raised, K, plant_T, plant_L).settle < plain.settle / 2);
+	CHECK(heatUp(raised, K, plant_T, plant_L).overshoot < band);
+	return checkResult();
+}
@@ -0,0 +1,62 @@
+/*
+ * hal_stub.cpp
+ *
+ *  The simulated HAL time, timers, GPIO and EEPROM for the host tests
+ */
+
+#include <string.h>
+#include "stm32f1xx_hal.h"
+
+static uint32_t	tick	= 0;
+
+extern "C" uint32_t HAL_GetTick(void) {
+	return tick;
+}
+
+extern "C" void HAL_SetTick(uint32_t ms) {
+	tick = ms;
+}
+
+TIM_TypeDef		sim_tim1, sim_tim2;
+GPIO_TypeDef	sim_gpioa, sim_gpiob;
+
+extern "C" GPIO_PinState HAL_GPIO_ReadPin(GPIO_TypeDef *port, uint16_t pin) {
+	return (port->IDR & pin)?GPIO_PIN_SET:GPIO_PIN_RESET;
+}
+
+extern "C" void HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state) {
+	if (state == GPIO_PIN_SET)
+		port->ODR |= pin;
+	else
+		port->ODR &= ~pin;
+}
+
+extern "C" void HAL_Delay(uint32_t ms) {
+	tick += ms;
+}
+
+uint8_t	sim_eeprom[4096];
+int32_t	sim_eeprom_writes_left	= -1;
+
+extern "C" HAL_StatusTypeDef HAL_I2C_IsDeviceReady(I2C_HandleTypeDef *hi2c, uint16_t addr, uint32_t trials, uint32_t timeout) {
+	return (sim_eeprom_writes_left == 0)?HAL_ERROR:HAL_OK;
+}
+
+extern "C" HAL_StatusTypeDef HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t addr, uint16_t mem_addr, uint16_t mem_size,
+		uint8_t *data, uint16_t size, uint32_t timeout) {
+	if (sim_eeprom_writes_left == 0 || mem_addr + size > sizeof(sim_eeprom)) return HAL_ERROR;
+	memcpy(data, &sim_eeprom[mem_addr], size);
+	return HAL_OK;
+}
+
+// The power is lost during the write: the page is corrupted, the IC does not respond any more
+extern "C" HAL_StatusTypeDef HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t addr, uint16_t mem_addr, uint16_t mem_size,
+		uint8_t *data, uint16_t size, uint32_t timeout) {
+	if (sim_eeprom_writes_left == 0 || mem_addr + size > sizeof(sim_eeprom)) return HAL_ERROR;
+	if (sim_eeprom_writes_left > 0 && --sim_eeprom_writes_left == 0) {
+		memset(&sim_eeprom[mem_addr], 0x5A, size);
+		return HAL_ERROR;
+	}
+	memcpy(&sim_eeprom[mem_addr], data, size);
+	return HAL_OK;
+}
@@ -0,0 +1,80 @@
+/*
+ * stm32f1xx_hal.h
+ *
+ *  The HAL stub for the host tests: the simulated time, the timer registers and the GPIO pins
+ *  used by the device classes (IRON, HOTGUN). The tests write and read the registers directly.
+ *  The I2C bus has the simulated EEPROM IC at24c32a only
+ */
+
+#ifndef STM32F1XX_HAL_H_STUB
+#define STM32F1XX_HAL_H_STUB
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+typedef struct __TIM_HandleTypeDef TIM_HandleTypeDef;
+typedef struct { uint8_t dummy; } I2C_HandleTypeDef;
+typedef enum { HAL_OK = 0, HAL_ERROR, HAL_BUSY, HAL_TIMEOUT } HAL_StatusTypeDef;
+#define I2C_MEMADD_SIZE_16BIT	(0x10U)
+
+typedef struct {
+	volatile uint32_t	CR1, PSC, ARR, CNT, CCR1, CCR2, CCR3, CCR4, CCMR1, CCMR2;
+} TIM_TypeDef;
+
+typedef struct {
+	volatile uint32_t	IDR, ODR;
+} GPIO_TypeDef;
+
+typedef enum { GPIO_PIN_RESET = 0, GPIO_PIN_SET } GPIO_PinState;
+
+extern TIM_TypeDef	sim_tim1, sim_tim2;
+extern GPIO_TypeDef	sim_gpioa, sim_gpiob;
+#define TIM1		(&sim_tim1)
+#define TIM2		(&sim_tim2)
+#define GPIOA		(&sim_gpioa)
+#define GPIOB		(&sim_gpiob)
+#define GPIO_PIN(n)	((uint16_t)(1U << (n)))
+#define GPIO_PIN_0	GPIO_PIN(0)
+#define GPIO_PIN_1	GPIO_PIN(1)
+#define GPIO_PIN_2	GPIO_PIN(2)
+#define GPIO_PIN_3	GPIO_PIN(3)
+#define GPIO_PIN_4	GPIO_PIN(4)
+#define GPIO_PIN_5	GPIO_PIN(5)
+#define GPIO_PIN_6	GPIO_PIN(6)
+#define GPIO_PIN_7	GPIO_PIN(7)
+#define GPIO_PIN_8	GPIO_PIN(8)
+#define GPIO_PIN_9	GPIO_PIN(9)
+#define GPIO_PIN_10	GPIO_PIN(10)
+#define GPIO_PIN_11	GPIO_PIN(11)
+#define GPIO_PIN_12	GPIO_PIN(12)
+#define GPIO_PIN_13	GPIO_PIN(13)
+#define GPIO_PIN_14	GPIO_PIN(14)
+#define GPIO_PIN_15	GPIO_PIN(15)
+
+#define __DMB()		__asm__ volatile("" ::: "memory")		// The single core: the compiler barrier is enough on the host
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t	HAL_GetTick(void);								// The simulated time, see hal_stub.cpp
+void		HAL_SetTick(uint32_t ms);						// Set the simulated time (host tests only)
+GPIO_PinState	HAL_GPIO_ReadPin(GPIO_TypeDef *port, uint16_t pin);
+void		HAL_GPIO_WritePin(GPIO_TypeDef *port, uint16_t pin, GPIO_PinState state);
+void		HAL_Delay(uint32_t ms);
+HAL_StatusTypeDef	HAL_I2C_IsDeviceReady(I2C_HandleTypeDef *hi2c, uint16_t addr, uint32_t trials, uint32_t timeout);
+HAL_StatusTypeDef	HAL_I2C_Mem_Read(I2C_HandleTypeDef *hi2c, uint16_t addr, uint16_t mem_addr, uint16_t mem_size,
+					uint8_t *data, uint16_t size, uint32_t timeout);
+HAL_StatusTypeDef	HAL_I2C_Mem_Write(I2C_HandleTypeDef *hi2c, uint16_t addr, uint16_t mem_addr, uint16_t mem_size,
+					uint8_t *data, uint16_t size, uint32_t timeout);
+
+// The simulated EEPROM: the memory and the number of the page writes before the power loss (-1 - never)
+extern uint8_t	sim_eeprom[4096];
+extern int32_t	sim_eeprom_writes_left;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+/*
+ * switch_test.cpp
+ *
+ *  The SWITCH debounce: the status is taken from the first reading only when the switch opts in (boot path),
+ *  the other switches average the readings as before
+ */
+
+#include "check.h"
+#include "stat.h"
+
+int main(void) {
+	SWITCH boot, plain;
+	boot.init(3, 500, 1000, 0, true);
+	plain.init(3, 500, 1000);
+	boot.update(1400);
+	plain.update(1400);
+	CHECK(boot.settled() && boot.status());						// Known after the first reading
+	CHECK(!plain.status());										// Averaged from zero, one reading is not enough
+	uint8_t n = 1;
+	while (!plain.status() && n < 20) {
+		plain.update(1400);
+		++n;
+	}
+	printf("plain switch turned on after %d readings\n", n);
+	CHECK(n > 1 && n < 20);
+
+	// One noisy reading does not change the status of the averaging switch
+	boot.update(0);
+	CHECK(boot.status());
+	return checkResult();
+}
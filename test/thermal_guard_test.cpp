@@ -0,0 +1,112 @@
+/*
+ * thermal_guard_test.cpp
+ *
+ *  The sensor check of the heater model (see THERMAL_GUARD) with the IRON and the Hot Air Gun parameters:
+ *  the open thermocouple (the reading jumps to the ADC maximum and stays), the shorted one (jumps to zero),
+ *  the single spike of the reading, the saturated reading from the start and the normal heat-up.
+ *  The tip removal is detected before the sensor fault, then the check is reset.
+ *  The IRON cold heat-up of the slow tips and the tips with the heat lag is not a runaway
+ */
+
+#include "check.h"
+#include "stat.h"
+#include "plant.h"
+#include "iron.h"
+#include "tools.h"
+
+typedef struct {
+	const char		*name;
+	THERMAL_GUARD	*guard;
+	int32_t			power;										// The steady power
+	uint16_t		sensor_cycles;
+} t_device;
+
+// Run the check with the temperature readings, return the period the fault was found or -1
+static int32_t run(THERMAL_GUARD &g, const int32_t *temp, uint16_t len, int32_t power) {
+	for (uint16_t n = 0; n < len; ++n) {
+		if (g.check(temp[n], temp[n], power, false) != THERMAL_GUARD::TG_OK)
+			return n;
+	}
+	return -1;
+}
+
+int main(void) {
+	THERMAL_GUARD iron(1999, 3, 256, 25, 150, 400, 25);		// See IRON
+	THERMAL_GUARD gun(99, 1, 768, 5, 15, 300, 3);			// See HOTGUN
+	const t_device dev[2] = {
+		{"IRON",	&iron,	300,	25},
+		{"Hot Gun",	&gun,	30,		3}
+	};
+	const uint16_t len = 200;
+	int32_t temp[len];
+	for (uint8_t d = 0; d < 2; ++d) {
+		THERMAL_GUARD &g = *dev[d].guard;
+		int32_t step = 50;										// The steady temperature, then the step
+		for (uint16_t n = 0; n < len; ++n) temp[n] = (n < step)?1500:4095;
+		g.clear();
+		int32_t open = run(g, temp, len, dev[d].power);
+		CHECK(open >= step && open < step + dev[d].sensor_cycles + 1);
+		CHECK(g.fault() == THERMAL_GUARD::TG_SENSOR);
+
+		for (uint16_t n = 0; n < len; ++n) temp[n] = (n < step)?1500:0;
+		g.clear();
+		int32_t shorted = run(g, temp, len, dev[d].power);
+		CHECK(shorted >= step && shorted < step + dev[d].sensor_cycles + 1);
+
+		for (uint16_t n = 0; n < len; ++n) temp[n] = (n == step)?3000:1500;
+		g.clear();
+		int32_t spike = run(g, temp, len, dev[d].power);
+		CHECK(spike < 0);
+
+		for (uint16_t n = 0; n < len; ++n) temp[n] = 4095;
+		g.clear();
+		int32_t saturated = run(g, temp, len, dev[d].power);
+		CHECK(saturated > 0 && saturated <= dev[d].sensor_cycles);
+
+		for (uint16_t n = 0; n < len; ++n) temp[n] = 200 + n * 15;	// The heat-up
+		g.clear();
+		int32_t heat_up = run(g, temp, len, dev[d].power);
+		CHECK(heat_up < 0);
+
+		// The tip is removed: the reading is saturated till the removal is detected, the check is reset then
+		for (uint16_t n = 0; n < len; ++n) temp[n] = (n < step || n >= step + dev[d].sensor_cycles - 1)?1500:4095;
+		g.clear();
+		int32_t removed = run(g, temp, step + dev[d].sensor_cycles - 1, dev[d].power);
+		g.reset();
+		if (removed < 0)
+			removed = run(g, &temp[step + dev[d].sensor_cycles - 1], len - step - dev[d].sensor_cycles + 1, dev[d].power);
+		CHECK(removed < 0);
+		printf("%-8s open %d, shorted %d, spike %d, saturated %d, heat-up %d, removed %d\n", dev[d].name,
+				open, shorted, spike, saturated, heat_up, removed);
+	}
+
+	// The estimated rate lags the heat-up, then overshoots: the gain should not be learned from the start of it
+	const double	tip_t[3]	= {1500, 2500, 3500};		// The tip time constant, 20 ms periods
+	const uint16_t	tip_l[2]	= {2, 10};					// The tip heat lag, 20 ms periods
+	for (uint8_t i = 0; i < 3; ++i) {
+		for (uint8_t j = 0; j < 2; ++j) {
+			PLANT	tip(15000.0, tip_t[i], tip_l[j]);
+			IRON	*pIron = new IRON;
+			HAL_SetTick(1);
+			TIM2->CCR1 = 0;
+			pIron->init();
+			pIron->load(PIDparam(2300, 50, 735));			// The default IRON PID coefficients, see config.cpp
+			pIron->setFeedForward(17);
+			pIron->setTemp(3000);
+			pIron->switchPower(true);
+			int32_t fault = -1;
+			for (uint16_t n = 0; n < 1000 && fault < 0; ++n) {
+				uint16_t p = constrain(pIron->power(lround(tip.read())), 0, 1960);
+				TIM2->CCR1 = p;								// The power applied, see controlTask()
+				tip.step(p / 2000.0);
+				HAL_SetTick(HAL_GetTick() + 20);
+				if (pIron->thermalFault() != THERMAL_GUARD::TG_OK)
+					fault = n;
+			}
+			printf("IRON heat-up, tip time constant %.0f, lag %u: fault %d\n", tip_t[i], tip_l[j], fault);
+			CHECK(fault < 0);
+			delete pIron;
+		}
+	}
+	return checkResult();
+}
@@ -0,0 +1,105 @@
+/*
+ * window_skip_sim.cpp
+ *
+ *  The temperature window scheduling of the IRON (see controlTask() and the TIM2.CH4 interrupt in core.cpp)
+ *  on the simulated T12 tip. The IRON class controls the plant; the window of every period is read or skipped
+ *  by the policy: the number of windows skipped after the steady reading. The heat-up time and the steady-state
+ *  ripple of the real tip temperature are reported for every policy
+ */
+
+#include <random>
+#include "check.h"
+#include "plant.h"
+#include "iron.h"
+#include "tools.h"
+
+static const uint16_t	tim2_ticks		= 2000;				// The same values as in core.cpp
+static const uint16_t	max_iron_pwm	= 1960;
+static const uint16_t	temp_set		= 3000;
+static const uint32_t	periods			= 3000;				// 60 seconds at 50 Hz
+static const uint32_t	ripple_from		= 2000;				// The steady-state ripple is measured in the last 20 seconds
+
+typedef struct {
+	double		heat_up;									// The time to reach the preset temperature - 1%, seconds
+	double		ripple;										// The peak-to-peak tip temperature in steady state
+	double		skipped;									// The skipped windows, %
+	double		power;										// The average power in steady state
+} t_result;
+
+static t_result simulate(uint8_t max_skip, double load = 0) {
+	IRON *iron = new IRON;									// Every run starts with the fresh controller state
+	PLANT tip = t12Plant();
+	std::mt19937 gen(1);
+	std::normal_distribution<double> noise(0.0, 2.0);		// The thermocouple noise, internal units rms
+	HAL_SetTick(1);
+	iron->init();
+	iron->load(PIDparam(2300, 50, 735));						// The default IRON PID coefficients, see config.cpp
+	iron->setTemp(temp_set);
+	iron->switchPower(true);
+	t_result r = {0, 0, 0, 0};
+	uint16_t ccr1	= 0;
+	uint8_t	 skip	= 0;
+	uint32_t skipped = 0;
+	double t_min = 1e9, t_max = 0, pwr = 0;
+	for (uint32_t n = 0; n < periods; ++n) {
+		if (n == ripple_from) tip.load(load);
+		if (skip) {											// TIM2.CH4 interrupt: the window is skipped
+			--skip;
+			++skipped;
+			if (skip == 0 && ccr1 > max_iron_pwm)			// The temperature is read in the next period
+				ccr1 = max_iron_pwm;
+		} else {											// The window is read, controlTask() calculates the power
+			int32_t t = lround(tip.read() + noise(gen));
+			uint16_t p		= iron->power(constrain(t, 0, 4095));
+			uint16_t max_pwm = max_iron_pwm;
+			if (max_skip && iron->isSteady()) {
+				skip	= max_skip;
+				max_pwm	= tim2_ticks;
+			}
+			ccr1 = constrain(p, 0, max_pwm);
+		}
+		TIM2->CCR1 = ccr1;
+		tip.step((double)ccr1 / tim2_ticks);				// TIM2.CCR1 is preloaded: the power is applied in the next period
+		HAL_SetTick(HAL_GetTick() + 20);
+		if (r.heat_up == 0 && tip.read() >= temp_set * 0.99)
+			r.heat_up = (n + 1) * 0.02;
+		if (n >= ripple_from) {
+			t_min = std::min(t_min, tip.read());
+			t_max = std::max(t_max, tip.read());
+			pwr	 += ccr1;
+		}
+	}
+	delete iron;
+	r.ripple	= t_max - t_min;
+	r.skipped	= skipped * 100.0 / periods;
+	r.power		= pwr / (periods - ripple_from);
+	return r;
+}
+
+int main(void) {
+	const uint8_t policy[3] = {0, 1, 3};
+	t_result r[3];
+	printf("skip  heat-up,s  ripple  skipped,%%  power\n");
+	for (uint8_t i = 0; i < 3; ++i) {
+		r[i] = simulate(policy[i]);
+		printf("%4d %10.2f %7.1f %10.1f %6.0f\n", policy[i], r[i].heat_up, r[i].ripple, r[i].skipped, r[i].power);
+	}
+	// The soldered joint in the last 20 seconds needs about 1200 of power
+	t_result h[3];
+	printf("loaded: the ripple is the temperature dip\n");
+	for (uint8_t i = 0; i < 3; ++i) {
+		h[i] = simulate(policy[i], 6000);
+		printf("%4d %10.2f %7.1f %10.1f %6.0f\n", policy[i], h[i].heat_up, h[i].ripple, h[i].skipped, h[i].power);
+	}
+	// The windows are read every period while the tip is heating up: the heat-up time does not depend on the policy
+	CHECK(r[0].heat_up > 0);
+	CHECK(r[1].heat_up == r[0].heat_up);
+	CHECK(r[2].heat_up == r[0].heat_up);
+	// The windows are skipped in steady state only
+	CHECK(r[0].skipped == 0);
+	CHECK(r[1].skipped > 10);
+	// Skipping one window keeps the ripple within the thermocouple noise band, see max_temp_skip in core.cpp
+	CHECK(r[1].ripple < r[0].ripple + 8);
+	CHECK(h[1].ripple < h[0].ripple + 10);
+	return checkResult();
+}